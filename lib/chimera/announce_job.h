@@ -0,0 +1,53 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef ANNOUNCE_JOB_H
+#define ANNOUNCE_JOB_H
+#include <scheduler/job.h>
+#include <util/time.h>
+
+class Chimera;
+
+/** Sends the UPDATE messages queued by Chimera::Announce().
+ *
+ * A joining peer tells about itself to every host it learned, which are
+ * more than a hundred on a large network. Each run sends at most
+ * Chimera::ANNOUNCE_BATCH of them, so they don't all come with the
+ * answers to the JOIN. The job ends when the queue is empty.
+ */
+class AnnounceJob : public Job
+{
+	Chimera* chimera_;
+
+	bool Start();
+
+public:
+
+	static const double PERIOD = 0.1;  /**< Seconds between two batches */
+
+	AnnounceJob(Chimera* chimera)
+		: Job(time::dtime(), REPEAT_PERIODIC, PERIOD),
+		  chimera_(chimera)
+	{}
+};
+
+#endif /* ANNOUNCE_JOB_H */
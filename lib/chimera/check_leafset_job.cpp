@@ -31,16 +31,18 @@
 #include "messages.h"
 #include "routing.h"
 
-bool CheckLeafsetJob::Start()
+void CheckLeafsetJob::ProbeSilent(std::vector<Host>& hosts, double now)
 {
-	std::string s;
-
-	std::vector<Host> leafset = routing_->getLeafset();
-	for (std::vector<Host>::iterator it = leafset.begin(); it != leafset.end(); ++it)
+	for (std::vector<Host>::iterator it = hosts.begin(); it != hosts.end(); ++it)
 	{
-		if (*it && !chimera_->Ping(*it))
+		if (!*it || it->GetLastHeard() > last_run_)
+			continue;
+
+		if (chimera_->Ping(*it))
+			probed_.push_back(*it);
+		else
 		{
-			it->SetFailureTime(time::dtime ());
+			it->SetFailureTime(now);
 			pf_log[W_WARNING] << "message send to host: " << *it
 					  << " failed at time: " << it->GetFailureTime() << "!";
 			if (it->GetSuccessAvg() < BAD_LINK)
@@ -50,21 +52,45 @@ bool CheckLeafsetJob::Start()
 			}
 		}
 	}
-	std::vector<Host> table = routing_->getRoutingTable();
-	for (std::vector<Host>::iterator it = table.begin(); it != table.end(); ++it)
+}
+
+bool CheckLeafsetJob::Start()
+{
+	std::string s;
+	double now = time::dtime();
+
+	/* Adapt the period to the churn seen by the previous pings. */
+	size_t silent = 0;
+	for (std::vector<Host>::iterator it = probed_.begin(); it != probed_.end(); ++it)
 	{
-		if (*it && !chimera_->Ping(*it))
+		if (it->GetLastHeard() >= last_run_)
+			continue;
+
+		silent++;
+		it->SetFailureTime(now);
+		if (it->GetSuccessAvg() < BAD_LINK)
 		{
-			it->SetFailureTime(time::dtime ());
-			pf_log[W_WARNING] << "message send to host: " << *it
-					  << " failed at time: " << it->GetFailureTime() << "!";
-			if (it->GetSuccessAvg() < BAD_LINK)
-			{
-				pf_log[W_DEBUG] << "Deleting " << *it;
-				routing_->remove(*it);
-			}
+			pf_log[W_DEBUG] << "Deleting " << *it << ", which doesn't answer";
+			routing_->remove(*it);
 		}
 	}
+	if (silent)
+		period_ = period_ / 2 > MIN_PERIOD ? period_ / 2 : MIN_PERIOD;
+	else
+		period_ = period_ * 1.25 < MAX_PERIOD ? period_ * 1.25 : MAX_PERIOD;
+	SetRepeatDelta(period_);
+	pf_log[W_DEBUG] << silent << "/" << probed_.size() << " pinged hosts didn't answer, "
+	                << "next check in " << period_ << "s";
+	probed_.clear();
+
+	/* Take the statistics of the previous pings into account. */
+	routing_->UpdateStats();
+
+	std::vector<Host> leafset = routing_->getLeafset();
+	ProbeSilent(leafset, now);
+	std::vector<Host> table = routing_->getRoutingTable();
+	ProbeSilent(table, now);
+	last_run_ = now;
 
 	/* send leafset exchange data every  3 times that pings the leafset */
 	if (count_ == 2)
@@ -26,6 +26,8 @@
 #ifndef CHECK_LEAFSET_JOB_H
 #define CHECK_LEAFSET_JOB_H
 
+#include <vector>
+#include <net/host.h>
 #include <scheduler/job.h>
 #include <util/time.h>
 
@@ -35,23 +37,44 @@ class Routing;
 /** Class to make the update of the leafset of a Host
  * When it's started by the scheduler, it will update delete bad link in the leafset and routing table
  * and send leafset update to hosts present in its leafset
+ *
+ * Any packet received from a host proves it is alive, so only the hosts
+ * we haven't heard of since the last run are pinged. When some of the
+ * pinged hosts didn't answer before the next run, the period is halved,
+ * otherwise it slowly grows back, between MIN_PERIOD and MAX_PERIOD.
  */
 class CheckLeafsetJob : public Job
 {
 	Chimera* chimera_;
 	Routing* routing_;
 	size_t count_;
+	double period_;
+	double last_run_;
+	std::vector<Host> probed_;
 
 	bool Start();
 
+	/** Ping the hosts we didn't hear of since the last run, and remove
+	 * those which can't be reached.
+	 */
+	void ProbeSilent(std::vector<Host>& hosts, double now);
+
 public:
 
+	static const double PERIOD = 20.0;      /**< Initial period, in seconds */
+	static const double MIN_PERIOD = 5.0;   /**< Period under churn, in seconds */
+	static const double MAX_PERIOD = 60.0;  /**< Period of a stable network, in seconds */
+
 	CheckLeafsetJob(Chimera* chimera, Routing* routing)
-		: Job(time::dtime(), REPEAT_PERIODIC, 20.0),
+		: Job(time::dtime(), REPEAT_PERIODIC, PERIOD),
 		  chimera_(chimera),
 		  routing_(routing),
-		  count_(0)
-	{}
+		  count_(0),
+		  period_(PERIOD),
+		  last_run_(0)
+	{
+		SetPriority(PRIORITY_HIGH);
+	}
 };
 
 #endif /* CHECK_LEAFSET_JOB_H */
@@ -23,25 +23,39 @@
  *
  */
 
+#include <fstream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <stdio.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <arpa/inet.h>
 
 #include <net/network.h>
 #include <net/hosts_list.h>
 #include <net/addr_list.h>
 #include <scheduler/scheduler_queue.h>
 #include <util/key.h>
+#include <util/time.h>
 #include <dht/dht.h>
 
+#include "announce_job.h"
 #include "check_leafset_job.h"
 #include "chimera.h"
+#include "join_job.h"
+#include "lookup_job.h"
 #include "messages.h"
+#include "probe_candidates_job.h"
+#include "refresh_rows_job.h"
 #include "routing.h"
+#include "snapshot_job.h"
 
 Chimera::Chimera(DHT *dht, uint16_t port, const Key& my_key)
 	: network(new Network(this)),
 	dht_(dht),
-	routing(NULL)
+	routing(NULL),
+	announcing(false)
 {
 	network->Start();
 
@@ -67,8 +81,12 @@ Chimera::Chimera(DHT *dht, uint16_t port, const Key& my_key)
 	packet_type_list.RegisterType(ChimeraUpdateType);
 	packet_type_list.RegisterType(ChimeraPiggyType);
 	packet_type_list.RegisterType(ChimeraJoinNAckType);
+	packet_type_list.RegisterType(ChimeraJoinStateType);
 	packet_type_list.RegisterType(ChimeraPingType);
 	packet_type_list.RegisterType(ChimeraChatType);
+	packet_type_list.RegisterType(ChimeraLookupType);
+	packet_type_list.RegisterType(ChimeraLookupAckType);
+	packet_type_list.RegisterType(ChimeraRowRequestType);
 
 	fd = network->Listen(port, "0.0.0.0");
 
@@ -80,6 +98,23 @@ bool Chimera::Send(const Host& dest, const Packet& pckt)
 	return network->Send(fd, dest, pckt);
 }
 
+bool Chimera::SendPiggy(const Host& dest, const std::vector<Host>& hosts)
+{
+	bool success = true;
+	for(size_t first = 0; first < hosts.size(); first += MAX_ADDRESSES)
+	{
+		addr_list addresses;
+		for(size_t i = first; i < hosts.size() && i < first + MAX_ADDRESSES; ++i)
+			addresses.push_back(hosts[i].GetAddr());
+
+		Packet piggy(ChimeraPiggyType, GetMe().GetKey(), dest.GetKey());
+		piggy.SetArg(CHIMERA_PIGGY_ADDRESSES, addresses);
+		if(!Send(dest, piggy))
+			success = false;
+	}
+	return success;
+}
+
 bool Chimera::SendToNeighbours(const uint32_t number, const Packet& pckt)
 {
 	bool success = false;
@@ -140,21 +175,235 @@ void Chimera::HandleMessage(const Host& sender, const Packet& pckt)
 	}
 }
 
-void Chimera::Join(const Host& bootstrap)
+void Chimera::Join(const Host& bootstrap, JoinJob::Mode mode)
 {
 	if(bootstrap == InvalidHost)
 	{
 		/* We are the first peer here */
-		scheduler_queue.Queue(new CheckLeafsetJob(this, GetRouting()));
+		JoinStatus status;
+		status.state = JoinStatus::JOINED;
+		status.start_time = time::dtime();
+		SetJoinStatus(status);
+
+		StartMaintenance();
 		return;
 	}
 
-	Packet pckt(ChimeraJoinType, GetMe().GetKey(), bootstrap.GetKey());
-	pckt.SetArg(CHIMERA_JOIN_ADDRESS, GetMe().GetAddr());
-	if(!Send(bootstrap, pckt))
-		pf_log[W_WARNING] << "Chimera::Join: failed to contact bootstrap host " << bootstrap;
+	/* The JOIN messages are sent and retried without holding a thread. */
+	(new JoinJob(this, bootstrap, mode))->Launch();
+}
+
+void Chimera::StartMaintenance()
+{
+	scheduler_queue.Queue(new CheckLeafsetJob(this, GetRouting()));
+	scheduler_queue.Queue(new ProbeCandidatesJob(this, GetRouting()));
+	scheduler_queue.Queue(new RefreshRowsJob(this, GetRouting()));
+}
+
+bool Chimera::SendJoinState(const Host& joiner)
+{
+	/* The joining peer shares our rows up to its prefix length with us,
+	 * and its leafset is close to ours. */
+	std::vector<Host> hosts = routing->getLeafset();
+	size_t prefix = routing->getRowIndex(joiner.GetKey());
+	for(size_t row = 0; row <= prefix && row < RoutingTable::MAX_ROW; ++row)
+	{
+		std::vector<Host> cells = routing->getRow(row);
+		hosts.insert(hosts.end(), cells.begin(), cells.end());
+	}
+
+	std::set<Key> keys;
+	keys.insert(me.GetKey());
+	keys.insert(joiner.GetKey());
+	addr_list addresses;
+	addresses.push_back(me.GetAddr());
+	for(std::vector<Host>::iterator it = hosts.begin(); it != hosts.end(); ++it)
+		if(keys.insert(it->GetKey()).second)
+			addresses.push_back(it->GetAddr());
+
+	/* The fragment numbers are sent as 32 bits integers. */
+	size_t nb_fragments = (addresses.size() + MAX_ADDRESSES - 1) / MAX_ADDRESSES;
+	if(nb_fragments > std::numeric_limits<uint32_t>::max())
+		nb_fragments = std::numeric_limits<uint32_t>::max();
+	uint32_t count = static_cast<uint32_t>(nb_fragments);
+	bool success = true;
+	for(uint32_t fragment = 0; fragment < count; ++fragment)
+	{
+		addr_list part;
+		for(size_t i = fragment * MAX_ADDRESSES; i < addresses.size() && i < (fragment + 1) * MAX_ADDRESSES; ++i)
+			part.push_back(addresses[i]);
+
+		Packet state(ChimeraJoinStateType, me.GetKey(), joiner.GetKey());
+		state.SetArg(CHIMERA_JOIN_STATE_FRAGMENT, fragment);
+		state.SetArg(CHIMERA_JOIN_STATE_COUNT, count);
+		state.SetArg(CHIMERA_JOIN_STATE_ADDRESSES, part);
+		if(!Send(joiner, state))
+			success = false;
+	}
+
+	pf_log[W_ROUTING] << "Sent " << addresses.size() << " hosts to " << joiner
+	                  << " in " << count << " JOIN_STATE messages";
+	return success;
+}
+
+void Chimera::Announce(const std::vector<Host>& hosts)
+{
+	BlockLockMutex lock(&announce_mutex);
+
+	for(std::vector<Host>::const_iterator it = hosts.begin(); it != hosts.end(); ++it)
+	{
+		if(it->GetKey() != me.GetKey() && announce_keys.insert(it->GetKey()).second)
+			announce_queue.push_back(*it);
+	}
+
+	if(!announcing && !announce_queue.empty())
+	{
+		announcing = true;
+		scheduler_queue.Queue(new AnnounceJob(this));
+	}
+}
+
+size_t Chimera::AnnounceBatch()
+{
+	std::vector<Host> batch;
+	{
+		BlockLockMutex lock(&announce_mutex);
+
+		while(!announce_queue.empty() && batch.size() < ANNOUNCE_BATCH)
+		{
+			batch.push_back(announce_queue.front());
+			announce_keys.erase(announce_queue.front().GetKey());
+			announce_queue.pop_front();
+		}
+	}
+
+	for(std::vector<Host>::iterator it = batch.begin(); it != batch.end(); ++it)
+	{
+		Packet update(ChimeraUpdateType, me.GetKey(), it->GetKey());
+		update.SetArg(CHIMERA_UPDATE_ADDRESS, me.GetAddr());
+		if(!Send(*it, update))
+			pf_log[W_ROUTING] << "Chimera::Announce: failed to update " << *it;
+	}
+
+	BlockLockMutex lock(&announce_mutex);
+	if(announce_queue.empty())
+		announcing = false;
+	return announce_queue.size();
+}
+
+size_t Chimera::LoadSnapshot(const std::string& filename)
+{
+	BlockLockMutex lock(&snapshot_mutex);
+	snapshot_file = filename;
+
+	std::vector<Host> hosts;
+	std::fstream fin;
+	fin.open(filename.c_str(), std::fstream::in);
+	if(fin)
+	{
+		std::string line;
+		while(std::getline(fin, line))
+		{
+			if(line.empty() || line[0] == '#')
+				continue;
+
+			std::istringstream fields(line);
+			std::string key, ip;
+			uint16_t port;
+			double latency;
+			float success_avg;
+			struct in_addr addr;
+			if(!(fields >> key >> ip >> port >> latency >> success_avg) || !inet_aton(ip.c_str(), &addr))
+			{
+				pf_log[W_ERR] << "Snapshot " << filename << ": malformed line '" << line << "'";
+				continue;
+			}
+			if(!(latency >= 0) || !(success_avg >= 0 && success_avg <= 1))
+			{
+				pf_log[W_ERR] << "Snapshot " << filename << ": value out of range in line '" << line << "'";
+				continue;
+			}
+
+			Host host = hosts_list.GetHost(pf_addr(addr.s_addr, port, Key(key)));
+			if(host.GetKey() == me.GetKey())
+				continue;
+
+			/* What we measured since we started is more accurate. */
+			if(host.GetLatency() <= 0)
+			{
+				host.UpdateLatency(latency);
+				host.SetSuccessAvg(success_avg);
+			}
+			hosts.push_back(host);
+		}
+		fin.close();
+	}
+
+	pf_log[W_INFO] << "Loaded " << hosts.size() << " hosts from snapshot " << filename;
+	if(!hosts.empty())
+	{
+		routing->add(hosts);
+		for(std::vector<Host>::iterator it = hosts.begin(); it != hosts.end(); ++it)
+			Ping(*it);
+	}
+	scheduler_queue.Queue(new SnapshotJob(this, routing, hosts));
 
-	/* TODO: lock here until join is done. */
+	return hosts.size();
+}
+
+bool Chimera::SaveSnapshot() const
+{
+	BlockLockMutex lock(&snapshot_mutex);
+	if(snapshot_file.empty())
+		return false;
+
+	std::vector<Host> hosts = routing->getLeafset();
+	std::vector<Host> table = routing->getRoutingTable();
+	hosts.insert(hosts.end(), table.begin(), table.end());
+
+	/* Written aside and renamed, so a crash never leaves half a snapshot. */
+	std::string tmp = snapshot_file + ".tmp";
+	std::fstream fout;
+	fout.open(tmp.c_str(), std::fstream::out);
+	if(!fout)
+	{
+		pf_log[W_ERR] << "Unable to save the snapshot in " << tmp;
+		return false;
+	}
+
+	fout << "# key address port latency success_avg" << std::endl;
+	fout.precision(6);
+	for(std::vector<Host>::iterator it = hosts.begin(); it != hosts.end(); ++it)
+	{
+		pf_addr addr = it->GetAddr();
+		struct in_addr in;
+		char ip[INET_ADDRSTRLEN];
+		in.s_addr = addr.ip[3];
+		if(!inet_ntop(AF_INET, &in, ip, sizeof ip))
+			continue;
+		fout << it->GetKey().GetStr() << " " << ip << " " << addr.port << " "
+		     << it->GetLatency() << " " << it->GetSuccessAvg() << std::endl;
+	}
+	fout.close();
+
+	if(!fout || rename(tmp.c_str(), snapshot_file.c_str()) != 0)
+	{
+		pf_log[W_ERR] << "Unable to save the snapshot in " << snapshot_file;
+		return false;
+	}
+	return true;
+}
+
+JoinStatus Chimera::GetJoinStatus() const
+{
+	BlockLockMutex lock(&join_mutex);
+	return join_status;
+}
+
+void Chimera::SetJoinStatus(const JoinStatus& status)
+{
+	BlockLockMutex lock(&join_mutex);
+	join_status = status;
 }
 
 bool Chimera::Route(const Packet& pckt)
@@ -192,8 +441,11 @@ bool Chimera::Route(const Packet& pckt)
 		return false;
 	}
 
-	/* XXX possibily an infinite loop? */
-	while(!Send(nextDest, pckt))
+	/* A host which doesn't acknowledge the packet is replaced by the
+	 * ResendPacketJob. This loop only handles local send errors, and
+	 * tries at most MAX_RETRY next hops. */
+	std::vector<Host> tried;
+	while(!network->Send(fd, nextDest, pckt, true))
 	{
 		nextDest.SetFailureTime(time::dtime());
 		pf_log[W_ROUTING] << "message sent to host: " << nextDest
@@ -204,30 +456,71 @@ bool Chimera::Route(const Packet& pckt)
 		if(nextDest.GetSuccessAvg() < BAD_LINK)
 			GetRouting()->remove(nextDest);
 
-		nextDest = GetRouting()->routeLookup(key);
+		tried.push_back(nextDest);
+		if(tried.size() < Network::MAX_RETRY)
+			nextDest = GetRouteCandidate(pckt, tried);
+		if(tried.size() >= Network::MAX_RETRY || !nextDest)
+		{
+			pf_log[W_ERR] << "Unable to route the packet to " << key << ", dropped.";
+			return true;
+		}
 		pf_log[W_ROUTING] << "rerouting through " << nextDest;
 	}
 
 	/* in each hop in the way to the key root nodes
-	 * send their routing info to the joining node. */
-	if(pckt.GetPacketType() == ChimeraJoinType)
+	 * send their routing info to the joining node, unless
+	 * the root sends it all at once. */
+	if(pckt.GetPacketType() == ChimeraJoinType && !pckt.GetArg<uint32_t>(CHIMERA_JOIN_BULK))
 		sendRowInfo(pckt);
 
 	pf_log[W_ROUTING] << "******* END OF ROUTING *******";
 	return true;
 }
 
+Host Chimera::GetRouteCandidate(const Packet& pckt, const std::vector<Host>& tried) const
+{
+	Key key = pckt.GetDst();
+
+	/* The joining node may be among them. */
+	std::vector<Host> candidates = routing->nextHops(key, tried.size() + 2);
+
+	for(std::vector<Host>::iterator it = candidates.begin(); it != candidates.end(); ++it)
+	{
+		if(it->GetKey() == key && pckt.GetPacketType() == ChimeraJoinType)
+			continue;
+
+		std::vector<Host>::const_iterator failed = tried.begin();
+		while(failed != tried.end() && failed->GetKey() != it->GetKey())
+			++failed;
+		if(failed == tried.end())
+			return *it;
+	}
+	return InvalidHost;
+}
+
+bool Chimera::Lookup(const Packet& pckt)
+{
+	Key key = pckt.GetDst();
+
+	if(key == me.GetKey())
+		return false;
+
+	std::vector<Host> next_hops = GetRouting()->nextHops(key, LookupJob::ALPHA);
+	if(next_hops.empty())
+	{
+		pf_log[W_ROUTING] << "I'm the closest know host of " << key << ", no lookup.";
+		return false;
+	}
+
+	(new LookupJob(this, pckt, next_hops))->Launch();
+	return true;
+}
+
 void Chimera::sendRowInfo(const Packet& pckt)
 {
 	Host host = hosts_list.GetHost(pckt.GetArg<pf_addr>(CHIMERA_JOIN_ADDRESS));
 
 	std::vector<Host> rowset = GetRouting()->rowLookup(host.GetKey());
-	addr_list addresses;
-	for(std::vector<Host>::iterator it = rowset.begin(); it != rowset.end(); ++it)
-		addresses.push_back(it->GetAddr());
-
-	Packet rowinfo(ChimeraPiggyType, GetMe().GetKey(), host.GetKey());
-	rowinfo.SetArg(CHIMERA_PIGGY_ADDRESSES, addresses);
-	if(!Send(host, rowinfo))
+	if(!SendPiggy(host, rowset))
 		pf_log[W_ERR] << "Sending row information to node " << host << " failed";
 }
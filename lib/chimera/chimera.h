@@ -26,8 +26,13 @@
 #ifndef CHIMERA_H
 #define CHIMERA_H
 
+#include <deque>
+#include <set>
 #include <net/packet_type_list.h>
 #include <net/host.h>
+#include <util/mutex.h>
+
+#include "join_job.h"
 
 class Network;
 class DHT;
@@ -42,6 +47,17 @@ class Chimera
 	Host me;
 	int fd;
 
+	Mutex join_mutex;
+	JoinStatus join_status;
+
+	Mutex snapshot_mutex;
+	std::string snapshot_file;
+
+	Mutex announce_mutex;
+	std::deque<Host> announce_queue;
+	std::set<Key> announce_keys;    /**< Keys of the queued hosts */
+	bool announcing;
+
 	void sendRowInfo(const Packet& pckt);
 
 public:
@@ -50,6 +66,14 @@ public:
 	 */
 	static const unsigned int GRACEPERIOD = 30;  /* seconds */
 
+	/** Addresses sent in one packet: 38 bytes each, so a packet with a
+	 ** few other arguments stays under Network::PACKET_MAX_SIZE.
+	 */
+	static const size_t MAX_ADDRESSES = 24;
+
+	/** UPDATE messages sent by each run of the AnnounceJob. */
+	static const size_t ANNOUNCE_BATCH = 16;
+
 	/** Create the Chimera routing layer
 	 *
 	 * @param dht a pointer to an instance of DHT. Can be null if Chimera is used alone.
@@ -74,8 +98,61 @@ public:
 	/** Join the Chimera network.
 	 * It tries to connect to a peer to join a Chimera network.
 	 * @param bootstrap  the peer to bootstrap on
+	 * @param mode  how the routing state is received, see JoinJob::Mode
+	 */
+	void Join(const Host& bootstrap, JoinJob::Mode mode = JoinJob::ROW_BY_ROW);
+
+	/** Start the repeated jobs which maintain the routing
+	 * infrastructure, once joined.
+	 */
+	void StartMaintenance();
+
+	/** Answer a bulk JOIN: send to the joining peer the rows of our
+	 * routing table it shares, our leafset and ourself, in JOIN_STATE
+	 * fragments of MAX_ADDRESSES.
+	 * @param joiner  the joining peer
+	 * @return  true if all the fragments are sent.
+	 */
+	bool SendJoinState(const Host& joiner);
+
+	/** Tell these hosts about us with an UPDATE message.
+	 *
+	 * The messages are sent by an AnnounceJob, ANNOUNCE_BATCH at a time,
+	 * so a joining peer doesn't send hundreds of them at once.
+	 * @param hosts  the hosts to announce ourself to.
+	 */
+	void Announce(const std::vector<Host>& hosts);
+
+	/** Send the next ANNOUNCE_BATCH queued UPDATE messages.
+	 * @return  the number of messages still queued.
+	 */
+	size_t AnnounceBatch();
+
+	/** Warm restart: load the hosts saved by a previous run.
+	 *
+	 * They are added to the leafset and routing table with their link
+	 * statistics, so packets are routed before the join completes, and
+	 * they are pinged. A SnapshotJob removes those which didn't answer,
+	 * then saves the snapshot in this file periodically.
+	 *
+	 * @param filename  the snapshot file, which doesn't need to exist
+	 * @return  the number of hosts loaded
 	 */
-	void Join(const Host& bootstrap);
+	size_t LoadSnapshot(const std::string& filename);
+
+	/** Save the leafset and routing table hosts, with their latency and
+	 * success average, in the file given to LoadSnapshot().
+	 *
+	 * It is called periodically, and should be called on shutdown.
+	 * @return  false if there is no snapshot file or it can't be written.
+	 */
+	bool SaveSnapshot() const;
+
+	/** @return the progress of the last Join() */
+	JoinStatus GetJoinStatus() const;
+
+	/** Update the progress of the join, used by the JoinJob. */
+	void SetJoinStatus(const JoinStatus& status);
 
 	/** Send a message directly to a peer.
 	 * @param destination  this is peer which will receive message.
@@ -84,6 +161,13 @@ public:
 	 */
 	bool Send(const Host& destination, const Packet& pckt);
 
+	/** Send hosts in PIGGY messages, split in packets of MAX_ADDRESSES.
+	 * @param destination  the peer which will add them to its routing infrastructure.
+	 * @param hosts  the hosts to send.
+	 * @return  true if all the packets are sent.
+	 */
+	bool SendPiggy(const Host& destination, const std::vector<Host>& hosts);
+
 	/** Send a message to a set of the closest neighbour.
 	 * @param number the number of peers to send to in each direction
 	 * @param pckt the packet to send.
@@ -96,10 +180,31 @@ public:
 	 * find a peer in his routing table to route the packet.
 	 *
 	 * @param pckt  Packet I try to route.
-	 * @return true if the packet is sent, false if I'm the best know destination.
+	 * @return true if the packet is sent (or dropped after Network::MAX_RETRY
+	 *         local errors), false if I'm the best know destination.
 	 */
 	bool Route(const Packet& pckt);
 
+	/** Get an other next hop for a routed packet.
+	 *
+	 * @param pckt  the routed packet
+	 * @param tried  the next hops which failed to take it
+	 * @return the best candidate of Routing::nextHops() which wasn't tried,
+	 *         or InvalidHost if none is left.
+	 */
+	Host GetRouteCandidate(const Packet& pckt, const std::vector<Host>& tried) const;
+
+	/** Send a packet to the owner of its destination Key, found with an
+	 * iterative lookup.
+	 *
+	 * The peers are asked for their next hops in parallel, and the packet
+	 * is sent directly to the owner, in the background. See LookupJob.
+	 *
+	 * @param pckt  Packet to send.
+	 * @return true if the lookup is started, false if I'm the best know destination.
+	 */
+	bool Lookup(const Packet& pckt);
+
 	/** Ping a peer.
 	 * @param dest  the destination host.
 	 * @return  true if the ping is correctly sent.
@@ -0,0 +1,246 @@
+/*
+ * Copyright(C) 2008 Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ * This file contains some code from the Chimera's Distributed Hash Table,
+ * written by CURRENT Lab, UCSB.
+ *
+ */
+
+#include <cstdlib>
+#include <sstream>
+
+#include <util/pf_log.h>
+#include <util/time.h>
+
+#include "chimera.h"
+#include "join_job.h"
+#include "messages.h"
+
+JoinStatus::JoinStatus()
+	: state(NOT_JOINED),
+	  attempts(0),
+	  nacks(0),
+	  timeouts(0),
+	  start_time(0),
+	  last_attempt(0),
+	  next_attempt(0),
+	  join_time(0)
+{
+}
+
+const char* JoinStatus::GetStateName(State state)
+{
+	switch(state)
+	{
+		case NOT_JOINED: return "not joined";
+		case WAITING_SLOT: return "waiting slot";
+		case JOINING: return "joining";
+		case BACKING_OFF: return "backing off";
+		case JOINED: return "joined";
+		case FAILED: return "failed";
+		default: break;
+	}
+	return "unknown";
+}
+
+std::string JoinStatus::GetStr() const
+{
+	std::ostringstream out;
+
+	out << GetStateName(state) << " through " << bootstrap.GetAddr().GetStr()
+	    << ": attempts=" << attempts << " nacks=" << nacks << " timeouts=" << timeouts;
+	if(state == JOINED)
+		out << " time=" << join_time << "s";
+	else if(state == BACKING_OFF)
+		out << " next in " << next_attempt - time::dtime() << "s";
+	return out.str();
+}
+
+Mutex JoinJob::slots_mutex;
+size_t JoinJob::slots_used = 0;
+
+/* The answer comes from the root of our key, which is seldom the
+ * bootstrap peer, but it must be for us: answers to other joining
+ * peers may be routed through this one. */
+JoinJob::JoinJob(Chimera* chimera, const Host& bootstrap, Mode mode)
+	: chimera_(chimera),
+	  mode_(mode),
+	  ack_(this, mode == BULK ? ChimeraJoinStateType : ChimeraJoinAckType, Key(), chimera->GetMe().GetKey()),
+	  nack_(this, ChimeraJoinNAckType, Key(), chimera->GetMe().GetKey()),
+	  deadline_(0),
+	  failures_(0),
+	  has_slot_(false)
+{
+	status_.bootstrap = bootstrap;
+	status_.start_time = time::dtime();
+}
+
+JoinJob::~JoinJob()
+{
+	ReleaseSlot();
+}
+
+bool JoinJob::AcquireSlot()
+{
+	BlockLockMutex lock(&slots_mutex);
+
+	if(!has_slot_)
+	{
+		if(slots_used >= MAX_CONCURRENT)
+			return false;
+		slots_used++;
+		has_slot_ = true;
+	}
+	return true;
+}
+
+void JoinJob::ReleaseSlot()
+{
+	BlockLockMutex lock(&slots_mutex);
+
+	if(has_slot_)
+	{
+		slots_used--;
+		has_slot_ = false;
+	}
+}
+
+double JoinJob::Jitter(double delay)
+{
+	return delay / 2 + delay / 2 * ((double) rand() / RAND_MAX);
+}
+
+double JoinJob::Backoff() const
+{
+	double backoff = RETRY_BASE;
+	for(size_t i = 1; i < failures_ && backoff < MAX_BACKOFF; ++i)
+		backoff *= 2;
+	if(backoff > MAX_BACKOFF)
+		backoff = MAX_BACKOFF;
+	return Jitter(backoff);
+}
+
+void JoinJob::SetState(JoinStatus::State state)
+{
+	status_.state = state;
+	chimera_->SetJoinStatus(status_);
+}
+
+void JoinJob::Retry(bool nack)
+{
+	ReleaseSlot();
+	failures_++;
+
+	if(status_.attempts >= MAX_ATTEMPTS)
+	{
+		pf_log[W_WARNING] << "Chimera::Join: failed to join through " << status_.bootstrap
+		                  << " after " << status_.attempts << " attempts, giving up";
+		SetState(JoinStatus::FAILED);
+		Finish();
+		return;
+	}
+
+	/* The bootstrap peer rejects us until its grace period is elapsed. */
+	double delay = Backoff();
+	if(nack)
+		delay += Chimera::GRACEPERIOD;
+
+	status_.next_attempt = time::dtime() + delay;
+	SetState(JoinStatus::BACKING_OFF);
+
+	pf_log[W_ROUTING] << "Re-sending JOIN message to " << status_.bootstrap
+	                  << " in " << delay << " sec";
+	SleepUntil(status_.next_attempt, SEND_JOIN);
+}
+
+void JoinJob::Run(int current)
+{
+	switch(current)
+	{
+		case SEND_JOIN:
+		{
+			/* A late answer to the previous JOIN. */
+			if(ack_.HasPacket())
+				goto joined;
+
+			if(!AcquireSlot())
+			{
+				SetState(JoinStatus::WAITING_SLOT);
+				SleepUntil(time::dtime() + Jitter(RETRY_BASE), SEND_JOIN);
+				break;
+			}
+
+			ack_.Reset();
+			nack_.Reset();
+			status_.attempts++;
+			status_.last_attempt = time::dtime();
+			SetState(JoinStatus::JOINING);
+
+			/* Routed to our own key, so its root answers. */
+			Packet pckt(ChimeraJoinType, chimera_->GetMe().GetKey(), chimera_->GetMe().GetKey());
+			pckt.SetArg(CHIMERA_JOIN_ADDRESS, chimera_->GetMe().GetAddr());
+			pckt.SetArg(CHIMERA_JOIN_BULK, (uint32_t) (mode_ == BULK));
+			if(!chimera_->Send(status_.bootstrap, pckt))
+				pf_log[W_WARNING] << "Chimera::Join: failed to contact bootstrap host " << status_.bootstrap;
+
+			deadline_ = status_.last_attempt + TIMEOUT;
+			Wait(deadline_, GOT_ANSWER);
+			break;
+		}
+		case GOT_ANSWER:
+			if(ack_.HasPacket())
+				goto joined;
+
+			if(nack_.HasPacket())
+			{
+				status_.nacks++;
+				Retry(true);
+				break;
+			}
+
+			if(TimedOut())
+			{
+				pf_log[W_ROUTING] << "JOIN request to " << status_.bootstrap << " timed out";
+				status_.timeouts++;
+				Retry(false);
+				break;
+			}
+
+			/* Woken up by an other packet. */
+			Wait(deadline_, GOT_ANSWER);
+			break;
+
+		default:
+			pf_log[W_ERR] << "JoinJob: unknown step " << current;
+			ReleaseSlot();
+			Finish();
+			break;
+	}
+	return;
+
+joined:
+	ReleaseSlot();
+	status_.join_time = time::dtime() - status_.start_time;
+	SetState(JoinStatus::JOINED);
+	pf_log[W_ROUTING] << "Joined the network through " << status_.bootstrap
+	                  << " in " << status_.join_time << " sec";
+	chimera_->StartMaintenance();
+	Finish();
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright(C) 2008 Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ * This file contains some code from the Chimera's Distributed Hash Table,
+ * written by CURRENT Lab, UCSB.
+ *
+ */
+
+#ifndef JOIN_JOB_H
+#define JOIN_JOB_H
+
+#include <string>
+
+#include <scheduler/async_job.h>
+#include <util/mutex.h>
+#include <net/host.h>
+#include <net/packet_waiter.h>
+
+class Chimera;
+
+/** Progress of the join of a Chimera node, for monitoring. */
+class JoinStatus
+{
+public:
+	enum State
+	{
+		NOT_JOINED,
+		WAITING_SLOT,   /**< Too many join attempts are in progress */
+		JOINING,        /**< A JOIN has been sent, waiting for the answer */
+		BACKING_OFF,    /**< Waiting before sending the next JOIN */
+		JOINED,
+		FAILED
+	};
+
+	JoinStatus();
+
+	State state;
+	Host bootstrap;
+	size_t attempts;       /**< JOIN messages sent */
+	size_t nacks;          /**< JOIN_NACK received */
+	size_t timeouts;       /**< JOIN without answer */
+	double start_time;     /**< Date the join was started */
+	double last_attempt;   /**< Date the last JOIN was sent */
+	double next_attempt;   /**< Date of the next JOIN, when backing off */
+	double join_time;      /**< Seconds it took to join, when joined */
+
+	static const char* GetStateName(State state);
+	std::string GetStr() const;
+};
+
+/** Join the Chimera network through a bootstrap peer.
+ *
+ * It sends a JOIN message and waits for the answer. On a JOIN_NACK, or
+ * without answer after a timeout, a new JOIN is sent after a jittered
+ * exponential backoff, so that the nodes restarting at the same time
+ * don't retry together. A JOIN_NACK also delays the retry by the
+ * Chimera::GRACEPERIOD of the bootstrap peer.
+ *
+ * At most MAX_CONCURRENT joins wait for an answer at the same time, in
+ * the whole process. The JOIN_ACK itself is handled by its message
+ * handler, which updates the routing. Once joined, the maintenance jobs
+ * are started.
+ */
+class JoinJob : public AsyncJob
+{
+public:
+	/** How the routing state of the joining peer is filled. */
+	enum Mode
+	{
+		ROW_BY_ROW,  /**< Each hop to the root sends its row in a PIGGY, the root its leafset in the JOIN_ACK */
+		BULK         /**< The root sends its rows and leafset in JOIN_STATE fragments */
+	};
+
+private:
+	Chimera* chimera_;
+	Mode mode_;
+	PacketWaiter ack_;
+	PacketWaiter nack_;
+	JoinStatus status_;
+	double deadline_;
+	size_t failures_;      /**< Consecutive failed attempts */
+	bool has_slot_;
+
+	enum
+	{
+		SEND_JOIN,
+		GOT_ANSWER
+	};
+
+	static Mutex slots_mutex;
+	static size_t slots_used;
+	bool AcquireSlot();
+	void ReleaseSlot();
+
+	/** @return a random delay between delay/2 and delay */
+	static double Jitter(double delay);
+	double Backoff() const;
+
+	void SetState(JoinStatus::State state);
+	void Retry(bool nack);
+	void Run(int step);
+
+public:
+	static const unsigned int TIMEOUT = 10;          /**< Seconds to wait for an answer */
+	static const unsigned int MAX_ATTEMPTS = 8;      /**< JOIN messages sent before giving up */
+	static const unsigned int RETRY_BASE = 2;        /**< Backoff after the first failure, in seconds */
+	static const unsigned int MAX_BACKOFF = 300;     /**< Maximum backoff, in seconds */
+	static const unsigned int MAX_CONCURRENT = 4;    /**< Joins waiting for an answer at the same time */
+
+	JoinJob(Chimera* chimera, const Host& bootstrap, Mode mode = ROW_BY_ROW);
+	~JoinJob();
+};
+
+#endif /* JOIN_JOB_H */
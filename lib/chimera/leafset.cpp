@@ -25,23 +25,44 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include "leafset.h"
-Leafset::Leafset(Host _me)
-	: me(_me)
+
+Leafset::Leafset(Host _me, size_t size)
+	: me(_me),
+	  me_key(_me.GetKey()),
+	  side_size(size / 2)
 {
 }
 
+Leafset::LeafVector& Leafset::getSide(const Key& key, Leaf* leaf)
+{
+	const Leafset* self = this;
+	return const_cast<LeafVector&>(self->getSide(key, leaf));
+}
+
+const Leafset::LeafVector& Leafset::getSide(const Key& key, Leaf* leaf) const
+{
+	leaf->key = key;
+	leaf->distance = me_key.ClockwiseDistance(key);
+	if(leaf->distance <= Key::Key_Half)
+		return leavesCW;
+
+	leaf->distance = key.ClockwiseDistance(me_key);
+	return leavesCCW;
+}
+
 std::string Leafset::GetStr() const
 {
-	HostVector::const_iterator it;
+	LeafVector::const_iterator it;
 	std::string leafset_str = "LEFT: ";
 
 	for(it = leavesCW.begin(); it != leavesCW.end(); it++)
-		leafset_str = leafset_str + it->GetKey().GetStr() + " ";
+		leafset_str = leafset_str + it->key.GetStr() + " ";
 
 	leafset_str = leafset_str + "\nRIGHT: ";
 	for(it = leavesCCW.begin(); it != leavesCCW.end(); it++)
-		leafset_str = leafset_str + it->GetKey().GetStr() + " ";
+		leafset_str = leafset_str + it->key.GetStr() + " ";
 
 	leafset_str = leafset_str +"\n" ;
 
@@ -51,102 +72,54 @@ std::string Leafset::GetStr() const
 bool Leafset::add(const Host& entry)
 {
 	pf_log[W_ROUTING] << "Trying to add an entry in the leafset: " << entry;
-	if(me.GetKey() == entry.GetKey())
+	Leaf leaf;
+	LeafVector& side = getSide(entry.GetKey(), &leaf);
+	leaf.host = entry;
+
+	if(!leaf.distance)
 	{
 		pf_log[W_ROUTING] << "Trying to add myself in the leafset ?";
 		return false;
 	}
 
-	HostVector::iterator it;
-
-	if(entry.GetKey() > me.GetKey())
-	{
-		for(it = leavesCW.begin(); it != leavesCW.end(); it++)
-		{
-			if(entry.GetKey() == it->GetKey())
-			{
-				pf_log[W_ROUTING] << "Entry already in the leafset, clockwise.";
-				return false;
-			}
-			else if(entry.GetKey() < it->GetKey())
-			{
-				pf_log[W_ROUTING] << "Insert entry clockwise.";
-				leavesCW.insert(it, entry);
-				/* If needed, remove the last host clockwise */
-				if(leavesCW.size() > ONE_SIDE_LEAFSET_SIZE)
-					leavesCW.pop_back();
-				return true;
-			}
-		}
-
-		/* Leafset is not full, add at the end. */
-		if(leavesCW.size() < ONE_SIDE_LEAFSET_SIZE)
-		{
-			pf_log[W_ROUTING] << "Insert entry clockwise.";
-			leavesCW.push_back(entry);
-			return true;
-		}
-	}
-	else
+	LeafVector::iterator it = std::lower_bound(side.begin(), side.end(), leaf);
+	if(it != side.end() && it->key == leaf.key)
 	{
-		for(it = leavesCCW.begin(); it != leavesCCW.end(); it++)
-		{
-			if(entry.GetKey() == it->GetKey())
-			{
-				pf_log[W_ROUTING] << "Entry already in the leafset, counter-clockwise.";
-				return false;
-			}
-			else if(entry.GetKey() > it->GetKey())
-			{
-				pf_log[W_ROUTING] << "Insert entry counter-clockwise.";
-				leavesCCW.insert(it, entry);
-				/* If needed, remove the last host clockwise */
-				if(leavesCCW.size() > ONE_SIDE_LEAFSET_SIZE)
-					leavesCCW.pop_back();
-				return true;
-			}
-		}
-
-		/* Leafset is not full, add at the end. */
-		if(leavesCCW.size() < ONE_SIDE_LEAFSET_SIZE)
-		{
-			pf_log[W_ROUTING] << "Insert entry counter-clockwise.";
-			leavesCCW.push_back(entry);
-			return true;
-		}
+		pf_log[W_ROUTING] << "Entry already in the leafset.";
+		return false;
 	}
 
-	return false;
+	/* Farther than all the hosts of a full side. */
+	if((size_t)(it - side.begin()) >= side_size)
+		return false;
+
+	pf_log[W_ROUTING] << "Insert entry " << (&side == &leavesCW ? "clockwise." : "counter-clockwise.");
+	side.insert(it, leaf);
+
+	/* If needed, remove the farthest host */
+	if(side.size() > side_size)
+		side.pop_back();
+	return true;
 }
 
 bool Leafset::remove(const Host& entry)
 {
 	pf_log[W_ROUTING] << "Trying to remove an entry from the leafset: " << entry;
-	if(entry.GetKey() == this->me.GetKey())
+	Leaf leaf;
+	LeafVector& side = getSide(entry.GetKey(), &leaf);
+
+	if(!leaf.distance)
 	{
 		pf_log[W_ROUTING] << "Trying to remove myself from the leafset ?";
 		return false;
 	}
 
-	HostVector::iterator it;
-
-	for (it = leavesCW.begin(); it != leavesCW.end(); ++it)
-	{
-		if(entry.GetKey() == it->GetKey())
-		{
-			pf_log[W_ROUTING] << "Entry removed.";
-			leavesCW.erase(it);
-			return true;
-		}
-	}
-	for (it = leavesCCW.begin(); it != leavesCCW.end(); ++it)
+	LeafVector::iterator it = std::lower_bound(side.begin(), side.end(), leaf);
+	if(it != side.end() && it->key == leaf.key)
 	{
-		if(entry.GetKey() == it->GetKey())
-		{
-			pf_log[W_ROUTING] << "Entry removed.";
-			leavesCCW.erase(it);
-			return true;
-		}
+		pf_log[W_ROUTING] << "Entry removed.";
+		side.erase(it);
+		return true;
 	}
 	return false;
 }
@@ -163,62 +136,63 @@ void Leafset::KeyUpdate(Host _me)
 	/* The leafset is defined around me's key, so when it changes, we drop all the others hosts. */
 	this->clear();
 	this->me = _me;
+	this->me_key = _me.GetKey();
 }
 
 Host Leafset::routeLookup(const Key& key , bool* inLeafset) const
 {
-	pf_log[W_ROUTING] << "Leafset contains " << *this;
-
-	HostVector::const_iterator it;
-	*inLeafset = true;
-
-	for (it = leavesCW.begin(); it != leavesCW.end(); ++it)
-	{
-		if(key == it->GetKey())
-			return *it;
-	}
+	Leaf leaf;
+	const LeafVector& side = getSide(key, &leaf);
+	const LeafVector& other = (&side == &leavesCW) ? leavesCCW : leavesCW;
 
-	for (it = leavesCCW.begin(); it != leavesCCW.end(); ++it)
-	{
-		if(key == it->GetKey())
-			return *it;
-	}
+	/* When a side isn't full, we know all the hosts on this half of the ring. */
+	*inLeafset = side.size() < side_size || side.empty() || !(side.back().distance < leaf.distance);
+	if(!*inLeafset)
+		return side.back().host;
 
-	*inLeafset = false;
+	/* The closest hosts are around the key's position in its side. */
+	LeafVector::const_iterator it = std::lower_bound(side.begin(), side.end(), leaf);
+	const Host* best = &me;
+	Key best_dist = me_key.distance(key);
 
-	if(key > me.GetKey())
+	if(it != side.end() && it->key.distance(key) < best_dist)
 	{
-		if(!leavesCW.empty())
-			return leavesCW.back();
+		best = &it->host;
+		best_dist = it->key.distance(key);
 	}
-	else if(key < me.GetKey())
+	if(it != side.begin() && (it - 1)->key.distance(key) < best_dist)
 	{
-		if(!leavesCCW.empty())
-			return leavesCCW.back();
+		best = &(it - 1)->host;
+		best_dist = (it - 1)->key.distance(key);
 	}
+	/* Past the last host of this side, the next one is the farthest of the other side. */
+	if(it == side.end() && !other.empty() && other.back().key.distance(key) < best_dist)
+		best = &other.back().host;
 
-	return me;
+	return *best;
 }
 
 std::vector<Host> Leafset::getCopy() const
 {
-	std::vector<Host> ret = leavesCW;
+	std::vector<Host> ret = getCWSide();
+	std::vector<Host> ccw = getCCWSide();
 
-	for(std::vector<Host>::const_iterator it = leavesCCW.begin();
-			it != leavesCCW.end();
-			it++)
-	{
-		ret.insert(ret.end(),*it);
-	}
+	ret.insert(ret.end(), ccw.begin(), ccw.end());
 	return ret;
 }
 
 std::vector<Host> Leafset::getCWSide() const
 {
-	return leavesCW;
+	std::vector<Host> ret;
+	for(LeafVector::const_iterator it = leavesCW.begin(); it != leavesCW.end(); ++it)
+		ret.push_back(it->host);
+	return ret;
 }
 
 std::vector<Host> Leafset::getCCWSide() const
 {
-	return leavesCCW;
+	std::vector<Host> ret;
+	for(LeafVector::const_iterator it = leavesCCW.begin(); it != leavesCCW.end(); ++it)
+		ret.push_back(it->host);
+	return ret;
 }
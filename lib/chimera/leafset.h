@@ -26,24 +26,49 @@
 #ifndef LEAFSET_H
 #define LEAFSET_H
 
-#define LEAFSET_SIZE 8		/* (must be even) excluding node itself */
-#define ONE_SIDE_LEAFSET_SIZE LEAFSET_SIZE/2
-
 #include <vector>
 #include <net/hosts_list.h>
 #include <util/key.h>
 
 /** The leafset contains the current peer's immediate neighbors in key space
  * It's used in order to route packet among the DHT
+ *
+ * Each side is sorted by the distance to the local node around the ring,
+ * so a key near zero is handled like any other one.
  */
 class Leafset
 {
+public :
+	/** Default number of hosts, excluding node itself. */
+	static const size_t DEFAULT_SIZE = 8;
+
 private :
+	/** A leafset entry */
+	struct Leaf
+	{
+		Key key;                              /** Key of the host */
+		Key distance;                         /** Distance from me, on this side of the ring */
+		Host host;
+
+		bool operator<(const Leaf& leaf) const { return distance < leaf.distance; }
+	};
+
 	Host me;                                      /** Local host descriptor */
+	Key me_key;                                   /** Key of the local host */
+	size_t side_size;                             /** Maximum number of hosts on each side */
+
+	typedef std::vector<Leaf> LeafVector;
+	LeafVector leavesCW;                          /** array that contains the clowise part of the leafset */
+	LeafVector leavesCCW;                         /** array that contains the counterclowise part of the leafset */
 
-	typedef std::vector<Host> HostVector;
-	HostVector leavesCW;                          /** array that contains the clowise part of the leafset */
-	HostVector leavesCCW;                         /** array that contains the counterclowise part of the leafset */
+	/** \brief Find the side of the ring of a key
+	 *
+	 * \param key  the key
+	 * \param leaf  its key and distance from me are set
+	 * \return  the side of the leafset the key belongs to
+	 */
+	LeafVector& getSide(const Key& key, Leaf* leaf);
+	const LeafVector& getSide(const Key& key, Leaf* leaf) const;
 
 public :
 	/** \brief Constructor
@@ -51,8 +76,9 @@ public :
 	 * Constructor, creates an empty leafset
 	 *
 	 * \param me the local node
+	 * \param size the maximum number of hosts, must be even
 	 */
-	Leafset(Host me);
+	Leafset(Host me, size_t size = DEFAULT_SIZE);
 
 	/** \brief Perfoms maintenance caused by a change in DHT key
 	 *
@@ -64,7 +90,11 @@ public :
 
 	/** \brief Add an entry to the leafset
 	 *
-	 * Adds en entry to the leafset. At the beginning of the DHT, it can be added on both sides of the leafset.
+	 * The entry goes on the clockwise side when its ClockwiseDistance from
+	 * the local node is at most half of the ring, and on the counterclockwise
+	 * side otherwise, so it is only on one side. It is kept if it is among
+	 * the side_size nearest hosts of this side, the farthest one is then
+	 * dropped when the side is full.
 	 *
 	 * \param entry the entry that should be added
 	 * \return true if it was added, false if it wasn't
@@ -84,9 +114,9 @@ public :
 	 *
 	 * Finds the best destination for the next step of routing to key.
 	 * First check if the key falls into the leafset. If it is the case,
-	 * find the peer responsible for it and return it. If the key is
-	 * outside of the leafset, return the leafset extremity which is the
-	 * closest to the destination.
+	 * find the peer numerically closest to it and return it, this can be
+	 * the local node. If the key is outside of the leafset, return the
+	 * leafset extremity which is the closest to the destination.
 	 *
 	 * @param key  routing destination
 	 * @param inLeafset  the function sets it to true if the key falls into the leafset
@@ -0,0 +1,229 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <algorithm>
+
+#include <net/addr_list.h>
+#include <net/hosts_list.h>
+#include <util/pf_log.h>
+#include <util/time.h>
+
+#include "chimera.h"
+#include "lookup_job.h"
+#include "messages.h"
+#include "routing.h"
+
+LookupJob::Candidate::Candidate(const Host& _host, const Key& key)
+	: host(_host),
+	  distance(_host.GetKey().distance(key)),
+	  state(NEW),
+	  waiter(NULL),
+	  sent(0),
+	  deadline(0)
+{
+}
+
+LookupJob::LookupJob(Chimera* chimera, const Packet& pckt, const std::vector<Host>& next_hops)
+	: chimera_(chimera),
+	  pckt_(pckt),
+	  key_(pckt.GetDst()),
+	  queries_(0),
+	  start_(time::dtime())
+{
+	for(std::vector<Host>::const_iterator it = next_hops.begin(); it != next_hops.end(); ++it)
+		AddCandidate(*it);
+}
+
+LookupJob::~LookupJob()
+{
+	for(std::vector<Candidate>::iterator it = candidates_.begin(); it != candidates_.end(); ++it)
+		delete it->waiter;
+}
+
+void LookupJob::AddCandidate(const Host& host)
+{
+	if(!host || !host.GetKey() || host.GetKey() == chimera_->GetMe().GetKey())
+		return;
+
+	for(std::vector<Candidate>::const_iterator it = candidates_.begin(); it != candidates_.end(); ++it)
+		if(it->host.GetKey() == host.GetKey())
+			return;
+
+	Candidate candidate(host, key_);
+	candidates_.insert(std::upper_bound(candidates_.begin(), candidates_.end(), candidate), candidate);
+}
+
+double LookupJob::QueryTimeout(const Host& host) const
+{
+	/* A latency of 0 was never measured, the other peers' is a hint. */
+	double latency = host.GetLatency();
+	if(latency <= 0)
+		latency = chimera_->GetRouting()->GetAverageLatency();
+
+	double timeout = 4 * latency;
+	if(timeout <= 0 || timeout > QUERY_TIMEOUT / 1000.0)
+		return QUERY_TIMEOUT / 1000.0;
+	if(timeout < MIN_QUERY_TIMEOUT / 1000.0)
+		return MIN_QUERY_TIMEOUT / 1000.0;
+	return timeout;
+}
+
+bool LookupJob::SendQuery(Candidate& candidate)
+{
+	/* Registered before the query is sent, not to miss a quick answer. */
+	candidate.waiter = new PacketWaiter(this, ChimeraLookupAckType, candidate.host.GetKey());
+	candidate.state = Candidate::QUERYING;
+	candidate.sent = time::dtime();
+	candidate.deadline = candidate.sent + QueryTimeout(candidate.host);
+	queries_++;
+
+	Packet query(ChimeraLookupType, chimera_->GetMe().GetKey(), candidate.host.GetKey());
+	query.SetArg(CHIMERA_LOOKUP_KEY, key_);
+	if(chimera_->Send(candidate.host, query))
+		return true;
+
+	candidate.state = Candidate::FAILED;
+	delete candidate.waiter;
+	candidate.waiter = NULL;
+	return false;
+}
+
+void LookupJob::Deliver(const Host& owner)
+{
+	pf_log[W_ROUTING] << "Lookup of " << key_ << " found " << owner << " in "
+	                  << time::dtime() - start_ << " sec, with " << queries_ << " queries";
+
+	if(!chimera_->Send(owner, pckt_))
+		pf_log[W_ROUTING] << "Sending the looked up packet to " << owner << " failed";
+}
+
+void LookupJob::Run(int)
+{
+	double now = time::dtime();
+	std::vector<Host> learned;
+	Host owner;
+
+	for(std::vector<Candidate>::iterator it = candidates_.begin(); it != candidates_.end() && !owner; ++it)
+	{
+		if(it->state != Candidate::QUERYING)
+			continue;
+
+		/* Skip the answers to the other lookups sent to the same peer. */
+		Packet answer;
+		bool answered = false;
+		while(!answered && it->waiter->TakePacket(&answer))
+			answered = answer.GetArg<Key>(CHIMERA_LOOKUP_ACK_KEY) == key_;
+
+		if(answered)
+		{
+			it->state = Candidate::ANSWERED;
+			it->host.UpdateStat(1);
+			it->host.UpdateLatency(now - it->sent);
+
+			/* Without any nearer host, the peer is the owner of the key. */
+			addr_list addresses = answer.GetArg<addr_list>(CHIMERA_LOOKUP_ACK_ADDRESSES);
+			if(addresses.empty())
+				owner = it->host;
+			for(addr_list::iterator addr = addresses.begin(); addr != addresses.end(); ++addr)
+				learned.push_back(hosts_list.GetHost(*addr));
+		}
+		else if(now >= it->deadline)
+		{
+			/* The timeout is short to keep the lookup going, it doesn't
+			 * mean the peer is dead: the CheckLeafsetJob decides it. */
+			pf_log[W_ROUTING] << "Lookup query to " << it->host << " timed out";
+			it->state = Candidate::FAILED;
+		}
+		else
+			continue;
+
+		delete it->waiter;
+		it->waiter = NULL;
+	}
+
+	if(owner)
+	{
+		Deliver(owner);
+		Finish();
+		return;
+	}
+
+	for(std::vector<Host>::iterator it = learned.begin(); it != learned.end(); ++it)
+		AddCandidate(*it);
+
+	/* Keep ALPHA queries in flight, to the nearest hosts first. */
+	size_t in_flight = 0;
+	for(std::vector<Candidate>::iterator it = candidates_.begin(); it != candidates_.end(); ++it)
+		if(it->state == Candidate::QUERYING)
+			in_flight++;
+
+	for(std::vector<Candidate>::iterator it = candidates_.begin();
+	    it != candidates_.end() && in_flight < ALPHA && queries_ < MAX_QUERIES;
+	    ++it)
+		if(it->state == Candidate::NEW && SendQuery(*it))
+			in_flight++;
+
+	if(in_flight == 0)
+	{
+		bool exhausted = true;
+		for(std::vector<Candidate>::iterator it = candidates_.begin(); it != candidates_.end(); ++it)
+			if(it->state == Candidate::NEW)
+				exhausted = false;
+
+		/* Nobody nearer answered. When all the hosts we heard of have been
+		 * queried, the nearest peer which answered is the nearest alive
+		 * one: it mustn't forward the packet to the dead hosts it knows. */
+		for(std::vector<Candidate>::iterator it = candidates_.begin(); it != candidates_.end(); ++it)
+			if(it->state == Candidate::ANSWERED)
+			{
+				if(exhausted)
+					pckt_.ClrFlag(Packet::MUSTROUTE);
+				Deliver(it->host);
+				Finish();
+				return;
+			}
+
+		if(exhausted)
+		{
+			/* All the hosts nearer than me are dead. */
+			pf_log[W_ROUTING] << "Lookup of " << key_ << ": I'm the nearest alive host, deliver the message.";
+			pckt_.ClrFlag(Packet::MUSTROUTE);
+			chimera_->HandleMessage(chimera_->GetMe(), pckt_);
+		}
+		else
+			pf_log[W_WARNING] << "Lookup of " << key_ << " failed after " << queries_ << " queries";
+		Finish();
+		return;
+	}
+
+	/* Wake up at the first timeout of the pending queries. */
+	double deadline = 0;
+	bool querying = false;
+	for(std::vector<Candidate>::iterator it = candidates_.begin(); it != candidates_.end(); ++it)
+		if(it->state == Candidate::QUERYING && (!querying || it->deadline < deadline))
+		{
+			deadline = it->deadline;
+			querying = true;
+		}
+
+	Wait(deadline, QUERY);
+}
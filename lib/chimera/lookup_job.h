@@ -0,0 +1,105 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef LOOKUP_JOB_H
+#define LOOKUP_JOB_H
+
+#include <vector>
+
+#include <scheduler/async_job.h>
+#include <net/host.h>
+#include <net/packet.h>
+#include <net/packet_waiter.h>
+
+class Chimera;
+
+/** Iterative lookup of the owner of a key.
+ *
+ * Instead of forwarding the packet hop by hop as Chimera::Route() does,
+ * the originator asks the peers for their next hops to the key, with
+ * ALPHA queries in flight at the same time. When a peer answers that it
+ * is the owner of the key, the packet is sent directly to it.
+ *
+ * A dead or slow peer only delays one query until its timeout, while the
+ * other queries go on, so it doesn't stall the whole lookup.
+ */
+class LookupJob : public AsyncJob
+{
+	struct Candidate
+	{
+		enum State
+		{
+			NEW,
+			QUERYING,
+			ANSWERED,
+			FAILED
+		};
+
+		Host host;
+		Key distance;            /**< Distance to the looked up key */
+		State state;
+		PacketWaiter* waiter;    /**< Waits for the answer, while querying */
+		double sent;             /**< Date the query was sent */
+		double deadline;         /**< Date the query times out */
+
+		Candidate(const Host& _host, const Key& key);
+
+		bool operator<(const Candidate& other) const { return distance < other.distance; }
+	};
+
+	Chimera* chimera_;
+	Packet pckt_;
+	Key key_;
+	std::vector<Candidate> candidates_;   /**< Sorted by distance to the key */
+	size_t queries_;
+	double start_;
+
+	enum
+	{
+		QUERY
+	};
+
+	void AddCandidate(const Host& host);
+	bool SendQuery(Candidate& candidate);
+
+	/** @return the query timeout of a host, from its measured latency */
+	double QueryTimeout(const Host& host) const;
+
+	void Deliver(const Host& owner);
+	void Run(int step);
+
+public:
+	static const unsigned int ALPHA = 3;              /**< Queries in flight at the same time */
+	static const unsigned int ANSWER_SIZE = 4;        /**< Next hops given in an answer */
+	static const unsigned int MAX_QUERIES = 32;       /**< Queries sent before giving up */
+	static const unsigned int QUERY_TIMEOUT = 1000;   /**< Maximum query timeout, in milliseconds */
+	static const unsigned int MIN_QUERY_TIMEOUT = 50; /**< Minimum query timeout, in milliseconds */
+
+	/** @param chimera  the routing layer
+	 * @param pckt  the packet to send to the owner of its destination key
+	 * @param next_hops  my next hops to the key, from Routing::nextHops()
+	 */
+	LookupJob(Chimera* chimera, const Packet& pckt, const std::vector<Host>& next_hops);
+	~LookupJob();
+};
+
+#endif /* LOOKUP_JOB_H */
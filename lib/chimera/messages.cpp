@@ -22,7 +22,6 @@
  * written by CURRENT Lab, UCSB.
  *
  */
-#include <unistd.h>
 
 #include <util/pf_log.h>
 #include <util/time.h>
@@ -30,12 +29,11 @@
 #include <net/packet.h>
 #include <net/addr_list.h>
 #include <net/packet_handler.h>
-#include <scheduler/scheduler_queue.h>
 
 #include "messages.h"
 #include "routing.h"
 #include "chimera.h"
-#include "check_leafset_job.h"
+#include "lookup_job.h"
 
 class ChimeraJoinMessage : public ChimeraMessage
 {
@@ -44,6 +42,8 @@ public:
 	  * If the transmit time is too long, a JOINNACK is returned.
 	  * If not, an JOINACK is answered, with all the peer's addresses
 	  * that are in the leafset.
+	  * A bulk JOIN is answered by JOIN_STATE messages instead, see
+	  * Chimera::SendJoinState().
 	  */
 	void Handle (Chimera& chimera, const Host&, const Packet& pckt)
 	{
@@ -63,6 +63,13 @@ public:
 			return;
 		}
 
+		if(pckt.GetArg<uint32_t>(CHIMERA_JOIN_BULK))
+		{
+			if(!chimera.SendJoinState(host))
+				pf_log[W_ROUTING] << "Send join state to " << host << " failed!";
+			return;
+		}
+
 		std::vector<Host> leafset = chimera.GetRouting()->getLeafset();
 		addr_list addresses;
 		for(std::vector<Host>::iterator it = leafset.begin(); it != leafset.end(); ++it)
@@ -83,7 +90,8 @@ public:
 	/** After receiving a JOINACK message, we add the received peers addresses
 	  * in the routing (leafset + routing table, depending on the peer).
 	  * This trigger the send of an update message to each addresses received
-	  * and each host in the routing table.
+	  * and each host in the routing table, see Chimera::Announce().
+	  * The maintenance jobs are started by the JoinJob.
 	  * TODO: don't handle this message after a succesfull join.
 	  */
 	void Handle (Chimera& chimera, const Host&, const Packet& pckt)
@@ -92,31 +100,37 @@ public:
 		std::vector<Host> hosts;
 
 		for(addr_list::iterator it = addresses.begin(); it != addresses.end(); ++it)
-		{
-			Host host = hosts_list.GetHost(*it);
-			chimera.GetRouting()->add(host);
-
-			Packet update(ChimeraUpdateType, chimera.GetMe().GetKey(), host.GetKey());
-			update.SetArg(CHIMERA_UPDATE_ADDRESS, chimera.GetMe().GetAddr());
-
-			if(!chimera.Send(host, update))
-				pf_log[W_ROUTING] << "ChimeraJoinAck: failed to update " << host;
-		}
+			hosts.push_back(hosts_list.GetHost(*it));
+		chimera.GetRouting()->add(hosts);
 
 		/* why do we do this ? - Michael */
-		hosts = chimera.GetRouting()->getRoutingTable();
-		for(std::vector<Host>::iterator it = hosts.begin(); it != hosts.end(); ++it)
-		{
-			Host host = *it;
-			Packet update(ChimeraUpdateType, chimera.GetMe().GetKey(), host.GetKey());
+		std::vector<Host> table = chimera.GetRouting()->getRoutingTable();
+		hosts.insert(hosts.end(), table.begin(), table.end());
+		chimera.Announce(hosts);
+	}
+};
 
-			update.SetArg(CHIMERA_UPDATE_ADDRESS, chimera.GetMe().GetAddr());
-			if(!chimera.Send(host, update))
-				pf_log[W_ROUTING] << "ChimeraJoinAck: failed to update " << host;
-		}
+class ChimeraJoinStateMessage : public ChimeraMessage
+{
+public:
+	/** A fragment of the routing state sent by the root of our key, after
+	  * a bulk JOIN. The hosts are added to the routing and told about us.
+	  * The fragments are independent, so a lost one only leaves gaps,
+	  * which the maintenance jobs fill.
+	  */
+	void Handle (Chimera& chimera, const Host&, const Packet& pckt)
+	{
+		addr_list addresses = pckt.GetArg<addr_list>(CHIMERA_JOIN_STATE_ADDRESSES);
+		std::vector<Host> hosts;
+
+		for(addr_list::iterator it = addresses.begin(); it != addresses.end(); ++it)
+			hosts.push_back(hosts_list.GetHost(*it));
+		chimera.GetRouting()->add(hosts);
+		chimera.Announce(hosts);
 
-		/* Start the check of leafset repeated job. */
-		scheduler_queue.Queue(new CheckLeafsetJob(&chimera, chimera.GetRouting()));
+		pf_log[W_ROUTING] << "JOIN_STATE " << pckt.GetArg<uint32_t>(CHIMERA_JOIN_STATE_FRAGMENT) + 1
+		                  << "/" << pckt.GetArg<uint32_t>(CHIMERA_JOIN_STATE_COUNT)
+		                  << ": " << hosts.size() << " hosts";
 	}
 };
 
@@ -124,18 +138,11 @@ class ChimeraJoinNAckMessage : public ChimeraMessage
 {
 public:
 	/** A JOIN_NACK message trigger the sending of another JOIN message
-	  * after some times.
+	  * after some times, by the JoinJob waiting for it.
 	  */
-	void Handle (Chimera& chimera, const Host&, const Packet& pckt)
+	void Handle (Chimera&, const Host& sender, const Packet&)
 	{
-		pf_addr addr = pckt.GetArg<pf_addr>(CHIMERA_JOIN_NACK_ADDRESS);
-		Host host = hosts_list.GetHost(addr);
-
-		pf_log[W_ROUTING] << "JOIN request rejected from " << host;
-		sleep(Chimera::GRACEPERIOD);
-		pf_log[W_ROUTING] << "Re-sending JOIN message to " << host;
-
-		chimera.Join(host);
+		pf_log[W_ROUTING] << "JOIN request rejected from " << sender;
 	}
 };
 
@@ -160,16 +167,18 @@ public:
 	void Handle (Chimera& chimera, const Host&, const Packet& pckt)
 	{
 		addr_list address = pckt.GetArg<addr_list>(CHIMERA_PIGGY_ADDRESSES);
+		std::vector<Host> hosts;
 		for(addr_list::iterator it = address.begin(); it != address.end(); ++it)
 		{
 			Host host = hosts_list.GetHost(*it);
 
 			/* After a peer failed, we wait some time before adding it back. */
 			if(time::dtime() - host.GetFailureTime() > Chimera::GRACEPERIOD)
-				chimera.GetRouting()->add(host);
+				hosts.push_back(host);
 			else
 				pf_log[W_ROUTING] << "Refused to add " << host << " to routing table";
 		}
+		chimera.GetRouting()->add(hosts);
 	}
 };
 
@@ -195,11 +204,66 @@ public:
 	}
 };
 
+class ChimeraLookupMessage : public ChimeraMessage
+{
+public:
+	/** A step of an iterative lookup: we answer with our next hops to the
+	  * key, or with no host if we are its owner.
+	  */
+	void Handle (Chimera& chimera, const Host& sender, const Packet& pckt)
+	{
+		Key key = pckt.GetArg<Key>(CHIMERA_LOOKUP_KEY);
+
+		std::vector<Host> hosts = chimera.GetRouting()->nextHops(key, LookupJob::ANSWER_SIZE);
+		addr_list addresses;
+		for(std::vector<Host>::iterator it = hosts.begin(); it != hosts.end(); ++it)
+			addresses.push_back(it->GetAddr());
+
+		Packet lookup_ack(ChimeraLookupAckType, chimera.GetMe().GetKey(), sender.GetKey());
+		lookup_ack.SetArg(CHIMERA_LOOKUP_ACK_KEY, key);
+		lookup_ack.SetArg(CHIMERA_LOOKUP_ACK_ADDRESSES, addresses);
+		if(!chimera.Send(sender, lookup_ack))
+			pf_log[W_ROUTING] << "Send lookup ACK message failed!";
+	}
+};
+
+class ChimeraLookupAckMessage : public ChimeraMessage
+{
+public:
+	/** The answer is read by the LookupJob waiting for it. */
+	void Handle (Chimera&, const Host&, const Packet&)
+	{
+	}
+};
+
+class ChimeraRowRequestMessage : public ChimeraMessage
+{
+public:
+	/** A peer repairs its routing table: we answer with our row, which
+	  * it shares when we have the same prefix.
+	  */
+	void Handle (Chimera& chimera, const Host& sender, const Packet& pckt)
+	{
+		uint32_t row = pckt.GetArg<uint32_t>(CHIMERA_ROW_REQUEST_ROW);
+		if(row >= RoutingTable::MAX_ROW)
+			return;
+
+		std::vector<Host> hosts = chimera.GetRouting()->getRow(row);
+		if(!chimera.SendPiggy(sender, hosts))
+			pf_log[W_ROUTING] << "Sending row " << row << " to " << sender << " failed";
+	}
+};
+
 PacketType      ChimeraJoinType(CHIMERA_JOIN,      new ChimeraJoinMessage,      Packet::REQUESTACK|
                                                                                 Packet::MUSTROUTE,   "JOIN",           /* CHIMERA_JOIN_ADDRESS */ T_ADDR,
+                                                                                                                     /* CHIMERA_JOIN_BULK */ T_UINT32,
                                                                                                                                                   T_END);
 PacketType   ChimeraJoinAckType(CHIMERA_JOIN_ACK,  new ChimeraJoinAckMessage,   Packet::REQUESTACK,  "JOIN_ACK", /* CHIMERA_JOIN_ACK_ADDRESSES */ T_ADDRLIST,
                                                                                                                                                   T_END);
+PacketType  ChimeraJoinStateType(CHIMERA_JOIN_STATE, new ChimeraJoinStateMessage, Packet::REQUESTACK, "JOIN_STATE", /* CHIMERA_JOIN_STATE_FRAGMENT */ T_UINT32,
+                                                                                                                /* CHIMERA_JOIN_STATE_COUNT */ T_UINT32,
+                                                                                                            /* CHIMERA_JOIN_STATE_ADDRESSES */ T_ADDRLIST,
+                                                                                                                                                  T_END);
 PacketType    ChimeraUpdateType(CHIMERA_UPDATE,    new ChimeraUpdateMessage,    Packet::REQUESTACK,  "UPDATE",       /* CHIMERA_UPDATE_ADDRESS */ T_ADDR,
                                                                                                                                                   T_END);
 PacketType     ChimeraPiggyType(CHIMERA_PIGGY,     new ChimeraPiggyMessage,     Packet::REQUESTACK,  "PIGGY",       /* CHIMERA_PIGGY_ADDRESSES */ T_ADDRLIST,
@@ -211,3 +275,10 @@ PacketType      ChimeraPingType(CIHMERA_PING,      new ChimeraPingMessage,
 PacketType      ChimeraChatType(CHIMERA_CHAT,      new ChimeraChatMessage,      Packet::REQUESTACK|
                                                                                 Packet::MUSTROUTE,   "CHAT",           /* CHIMERA_CHAT_MESSAGE */ T_STR,
                                                                                                                                                   T_END);
+PacketType    ChimeraLookupType(CHIMERA_LOOKUP,    new ChimeraLookupMessage,    0,                   "LOOKUP",           /* CHIMERA_LOOKUP_KEY */ T_KEY,
+                                                                                                                                                  T_END);
+PacketType ChimeraLookupAckType(CHIMERA_LOOKUP_ACK, new ChimeraLookupAckMessage, 0,                  "LOOKUP_ACK",   /* CHIMERA_LOOKUP_ACK_KEY */ T_KEY,
+                                                                                                         /* CHIMERA_LOOKUP_ACK_ADDRESSES */ T_ADDRLIST,
+                                                                                                                                                  T_END);
+PacketType ChimeraRowRequestType(CHIMERA_ROW_REQUEST, new ChimeraRowRequestMessage, Packet::REQUESTACK, "ROW_REQUEST", /* CHIMERA_ROW_REQUEST_ROW */ T_UINT32,
+                                                                                                                                                  T_END);
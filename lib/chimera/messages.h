@@ -39,7 +39,8 @@ public:
 
 enum
 {
-	CHIMERA_JOIN_ADDRESS
+	CHIMERA_JOIN_ADDRESS,
+	CHIMERA_JOIN_BULK
 };
 extern PacketType ChimeraJoinType;
 
@@ -68,6 +69,14 @@ enum
 };
 extern PacketType ChimeraJoinNAckType;
 
+enum
+{
+	CHIMERA_JOIN_STATE_FRAGMENT,
+	CHIMERA_JOIN_STATE_COUNT,
+	CHIMERA_JOIN_STATE_ADDRESSES
+};
+extern PacketType ChimeraJoinStateType;
+
 enum
 {
 	CHIMERA_PING_ME
@@ -80,4 +89,23 @@ enum
 };
 extern PacketType ChimeraChatType;
 
+enum
+{
+	CHIMERA_LOOKUP_KEY
+};
+extern PacketType ChimeraLookupType;
+
+enum
+{
+	CHIMERA_LOOKUP_ACK_KEY,
+	CHIMERA_LOOKUP_ACK_ADDRESSES
+};
+extern PacketType ChimeraLookupAckType;
+
+enum
+{
+	CHIMERA_ROW_REQUEST_ROW
+};
+extern PacketType ChimeraRowRequestType;
+
 #endif /* CHIMERA_MESSAGES_H */
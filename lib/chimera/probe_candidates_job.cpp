@@ -0,0 +1,46 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <util/pf_log.h>
+#include "probe_candidates_job.h"
+#include "chimera.h"
+#include "routing.h"
+
+bool ProbeCandidatesJob::Start()
+{
+	/* The latency of the hosts pinged last time is now known. */
+	if (!probed_.empty())
+	{
+		double before = routing_->GetAverageLatency();
+		if (routing_->add(probed_))
+			pf_log[W_ROUTING] << "Routing table average latency: " << before
+			                  << " -> " << routing_->GetAverageLatency();
+		probed_.clear();
+	}
+
+	std::vector<Host> candidates = routing_->TakeCandidates();
+	for (std::vector<Host>::iterator it = candidates.begin(); it != candidates.end(); ++it)
+		if (chimera_->Ping(*it))
+			probed_.push_back(*it);
+
+	return true;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef PROBE_CANDIDATES_JOB_H
+#define PROBE_CANDIDATES_JOB_H
+
+#include <vector>
+#include <net/host.h>
+#include <scheduler/job.h>
+#include <util/time.h>
+
+class Chimera;
+class Routing;
+
+/** Proximity neighbour selection.
+ *
+ * Hosts refused by full routing table cells are pinged to measure their
+ * latency, and on the next run they are added again: they replace the
+ * entries they are nearer than.
+ */
+class ProbeCandidatesJob : public Job
+{
+	Chimera* chimera_;
+	Routing* routing_;
+	std::vector<Host> probed_;
+
+	bool Start();
+
+public:
+
+	ProbeCandidatesJob(Chimera* chimera, Routing* routing)
+		: Job(time::dtime(), REPEAT_PERIODIC, 10.0),
+		  chimera_(chimera),
+		  routing_(routing)
+	{
+		SetPriority(PRIORITY_LOW);
+	}
+};
+
+#endif /* PROBE_CANDIDATES_JOB_H */
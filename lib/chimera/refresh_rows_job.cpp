@@ -0,0 +1,74 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <algorithm>
+#include <stdlib.h>
+#include <net/packet.h>
+#include <util/pf_log.h>
+#include "refresh_rows_job.h"
+#include "chimera.h"
+#include "messages.h"
+#include "routing.h"
+
+bool RefreshRowsJob::Start()
+{
+	std::vector<Host> peers = routing_->getLeafset();
+	std::vector<Host> table = routing_->getRoutingTable();
+	peers.insert(peers.end(), table.begin(), table.end());
+	if (peers.empty())
+		return true;
+
+	std::vector<size_t> prefixes;
+	size_t deepest = 0;
+	for (std::vector<Host>::iterator it = peers.begin(); it != peers.end(); ++it)
+	{
+		prefixes.push_back(routing_->getRowIndex(it->GetKey()));
+		deepest = std::max(deepest, prefixes.back());
+	}
+
+	std::vector<size_t> rows = routing_->TakeEmptiedRows();
+	if (next_row_ > deepest)
+		next_row_ = 0;
+	if (std::find(rows.begin(), rows.end(), next_row_) == rows.end())
+		rows.push_back(next_row_);
+	next_row_++;
+
+	for (std::vector<size_t>::iterator row = rows.begin(); row != rows.end(); ++row)
+	{
+		/* A peer which shares the row prefix has the same row, or a
+		 * row containing it. A random one spreads the requests. */
+		std::vector<Host> sharing;
+		for (size_t i = 0; i < peers.size(); ++i)
+			if (prefixes[i] >= *row)
+				sharing.push_back(peers[i]);
+		if (sharing.empty())
+			continue;
+
+		Host peer = sharing[(size_t) rand() % sharing.size()];
+		Packet request(ChimeraRowRequestType, chimera_->GetMe().GetKey(), peer.GetKey());
+		request.SetArg(CHIMERA_ROW_REQUEST_ROW, (uint32_t)*row);
+		if (!chimera_->Send(peer, request))
+			pf_log[W_ROUTING] << "Requesting row " << *row << " to " << peer << " failed";
+	}
+
+	return true;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef REFRESH_ROWS_JOB_H
+#define REFRESH_ROWS_JOB_H
+#include <scheduler/job.h>
+#include <util/time.h>
+
+class Chimera;
+class Routing;
+
+/** Routing table repair.
+ *
+ * Entries are only learned when joining, so after churn the cells stay
+ * empty. On each run, this job asks a peer which shares the prefix of a
+ * row for its own row: the rows in which a cell was emptied since the
+ * last run, and the next one of a round on the rows we have peers for.
+ * The answer is a PIGGY message, which fills the gaps.
+ */
+class RefreshRowsJob : public Job
+{
+	Chimera* chimera_;
+	Routing* routing_;
+	size_t next_row_;
+
+	bool Start();
+
+public:
+
+	static const double PERIOD = 15.0;  /**< Seconds between two runs */
+
+	RefreshRowsJob(Chimera* chimera, Routing* routing)
+		: Job(time::dtime() + PERIOD, REPEAT_PERIODIC, PERIOD),
+		  chimera_(chimera),
+		  routing_(routing),
+		  next_row_(0)
+	{
+		SetPriority(PRIORITY_LOW);
+	}
+};
+
+#endif /* REFRESH_ROWS_JOB_H */
@@ -23,56 +23,224 @@
  *
  */
 
+#include <algorithm>
+
 #include "routing.h"
 
-Routing::Routing(Host _me)
+Routing::Routing(Host _me, size_t leafset_size)
 	: me(_me),
 	routingTable(_me),
-	leafset(_me)
+	leafset(_me, leafset_size),
+	state(new RoutingState(_me, routingTable, leafset, 1)),
+	generation(1),
+	cacheHits(0),
+	cacheMisses(0)
+{
+}
+
+void Routing::Publish()
 {
+	/* A new generation invalidates all the memoized next hops. */
+	this->generation++;
+	this->state.Publish(new RoutingState(this->me, this->routingTable, this->leafset,
+	                                     this->generation));
 }
 
-void Routing::KeyUpdate(Host me)
+void Routing::KeyUpdate(Host _me)
 {
 	BlockLockMutex lock(this);
-	this->leafset.KeyUpdate(me);
-	this->routingTable.KeyUpdate(me);
+	this->leafset.KeyUpdate(_me);
+	this->routingTable.KeyUpdate(_me);
+	Publish();
+}
+
+bool Routing::addHost(const Host& host)
+{
+	if (this->leafset.add(host))
+		return true;
+
+	bool refused = false;
+	if (this->routingTable.add(host, &refused))
+		return true;
+
+	/* Its cell is full, but it may be nearer than the entries once we know its latency. */
+	if (refused && host.GetLatency() <= 0 && this->candidates.size() < MAX_CANDIDATES)
+	{
+		Key key = host.GetKey();
+		for (std::vector<Host>::const_iterator it = this->candidates.begin(); it != this->candidates.end(); ++it)
+			if (it->GetKey() == key)
+				return false;
+		this->candidates.push_back(host);
+	}
+	return false;
 }
 
 bool Routing::add(const Host& host)
 {
 	BlockLockMutex lock(this);
-	bool added = this->leafset.add(host);
-	if (!added)
-		added = this->routingTable.add(host);
+	bool added = addHost(host);
+	if (added)
+		Publish();
+	return added;
+}
+
+bool Routing::add(const std::vector<Host>& hosts)
+{
+	BlockLockMutex lock(this);
+	bool added = false;
+	for (std::vector<Host>::const_iterator it = hosts.begin(); it != hosts.end(); ++it)
+		if (addHost(*it))
+			added = true;
+	if (added)
+		Publish();
 	return added;
 }
 
+std::vector<Host> Routing::TakeCandidates()
+{
+	BlockLockMutex lock(this);
+	std::vector<Host> ret;
+	ret.swap(this->candidates);
+	return ret;
+}
+
+std::vector<size_t> Routing::TakeEmptiedRows()
+{
+	BlockLockMutex lock(this);
+	std::vector<size_t> ret;
+	ret.swap(this->emptiedRows);
+	return ret;
+}
+
+double Routing::GetAverageLatency() const
+{
+	RcuPointer<RoutingState>::Reader current(&this->state);
+	return current->routingTable.GetAverageLatency();
+}
+
 bool Routing::remove(const Host& host)
 {
 	BlockLockMutex lock(this);
 	bool removed = this->leafset.remove(host);
 	if (!removed)
-		removed = this->routingTable.remove(host);
+	{
+		bool emptied = false;
+		removed = this->routingTable.remove(host, &emptied);
+		if (emptied)
+		{
+			size_t row = this->routingTable.getRowIndex(host.GetKey());
+			if (std::find(emptiedRows.begin(), emptiedRows.end(), row) == emptiedRows.end())
+				emptiedRows.push_back(row);
+		}
+	}
+	if (removed)
+		Publish();
 	return removed;
 }
 
-Host Routing::routeLookup(const Key& key) const
+void Routing::UpdateStats()
 {
 	BlockLockMutex lock(this);
+	if (this->routingTable.UpdateStats())
+		Publish();
+}
+
+Host Routing::routeLookup(const Key& key) const
+{
+	RcuPointer<RoutingState>::Reader current(&this->state);
+	NextHopSlot& slot = this->nextHopCache[KeyHash()(key) % NEXT_HOP_CACHE_SIZE];
+	Host host;
+
+	if (slot.TryLock())
+	{
+		if (slot.generation == current->generation && slot.key == key)
+			host = slot.host;
+		slot.Unlock();
+	}
+
+	if (host)
+	{
+		__sync_fetch_and_add(&this->cacheHits, 1);
+		return host;
+	}
+	__sync_fetch_and_add(&this->cacheMisses, 1);
+
+	host = lookup(*current, key);
+
+	if (host && slot.TryLock())
+	{
+		slot.generation = current->generation;
+		slot.key = key;
+		slot.host = host;
+		slot.Unlock();
+	}
+	return host;
+}
+
+/** A known host and its distance to a looked up key. */
+struct NextHop
+{
+	Key distance;
+	Host host;
+
+	NextHop(const Key& key, const Host& _host)
+		: distance(_host.GetKey().distance(key)),
+		  host(_host)
+	{}
+
+	bool operator<(const NextHop& other) const { return distance < other.distance; }
+};
+
+std::vector<Host> Routing::nextHops(const Key& key, size_t count) const
+{
+	RcuPointer<RoutingState>::Reader current(&this->state);
+	std::vector<Host> hosts;
+
+	Host best = lookup(*current, key);
+	if(!best || best.GetKey() == current->me_key || count == 0)
+		return hosts;
+	hosts.push_back(best);
+
+	std::vector<Host> known = current->leafset.getCopy();
+	std::vector<Host> table = current->routingTable.getCopy();
+	known.insert(known.end(), table.begin(), table.end());
+
+	Key my_distance = current->me_key.distance(key);
+	std::vector<NextHop> nearer;
+	for(std::vector<Host>::const_iterator it = known.begin(); it != known.end(); ++it)
+		if(it->GetKey() != best.GetKey() && it->GetKey().distance(key) < my_distance)
+			nearer.push_back(NextHop(key, *it));
+	std::sort(nearer.begin(), nearer.end());
+
+	/* A host can be both in the leafset and in the routing table. */
+	for(std::vector<NextHop>::const_iterator it = nearer.begin(); it != nearer.end() && hosts.size() < count; ++it)
+		if(it == nearer.begin() || it->host.GetKey() != (it - 1)->host.GetKey())
+			hosts.push_back(it->host);
+
+	return hosts;
+}
+
+void Routing::GetCacheStats(unsigned long* hits, unsigned long* misses) const
+{
+	*hits = this->cacheHits;
+	*misses = this->cacheMisses;
+}
+
+Host Routing::lookup(const RoutingState& current, const Key& key) const
+{
 	bool b;
 	pf_log[W_ROUTING] << "Look if it's for me";
-	if(this->me.GetKey() == key)
-		return this->me;
+	if(current.me_key == key)
+		return current.me;
 
 	pf_log[W_ROUTING] << "Lookup in the leafset table";
-	Host leafsetBest = this->leafset.routeLookup(key , &b);
+	Host leafsetBest = current.leafset.routeLookup(key , &b);
 	if(b)
 	{
 		return leafsetBest;
 	}
 	pf_log[W_ROUTING] << "..failed.. Lookup in the routing table";
-	Host routingTableBest = this->routingTable.routeLookup(key , &b);
+	Host routingTableBest = current.routingTable.routeLookup(key , &b);
 	if(b)
 	{
 		return routingTableBest;
@@ -89,19 +257,21 @@ Host Routing::routeLookup(const Key& key) const
 		return routingTableBest;
 	}
 	//distance is the same
-	if(leafsetBest == this->me)
+	if(leafsetBest == current.me)
 	{
 		return leafsetBest;
 	}
 	return routingTableBest;
 }
 
-const Leafset* Routing::GetLeafset() const
+Leafset Routing::GetLeafset() const
 {
-	return &leafset;
+	RcuPointer<RoutingState>::Reader current(&this->state);
+	return current->leafset;
 }
 
-const RoutingTable* Routing::GetRoutingTable() const
+RoutingTable Routing::GetRoutingTable() const
 {
-	return &routingTable;
+	RcuPointer<RoutingState>::Reader current(&this->state);
+	return current->routingTable;
 }
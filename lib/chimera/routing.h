@@ -28,15 +28,39 @@
 #include <vector>
 #include <net/host.h>
 #include <util/mutex.h>
+#include <util/rcu.h>
 #include "leafset.h"
 #include "routing_table.h"
 
 class HostsList;
 
+/** A version of the routing infrastructure, read by lookups. */
+class RoutingState
+{
+public:
+	Host me;                    /** Local host descriptor */
+	Key me_key;                 /** Key of the local host */
+	RoutingTable routingTable;  /** DHT routing table */
+	Leafset leafset;            /** DHT leafset */
+	unsigned long generation;   /** Number of this version */
+
+	RoutingState(const Host& _me, const RoutingTable& _routingTable, const Leafset& _leafset,
+	             unsigned long _generation)
+		: me(_me),
+		  me_key(_me.GetKey()),
+		  routingTable(_routingTable),
+		  leafset(_leafset),
+		  generation(_generation)
+	{}
+};
+
 /** Class used for routing packet among the DHT using Key Based Routing
  *
  * Find the best next host to send the packet according to the final destination
  *
+ * The mutex only serializes the updates. Each change publishes a new
+ * RoutingState, and lookups read the current one without locking. The
+ * versions share the routing table rows which haven't changed.
  */
 class Routing : protected Mutex
 {
@@ -44,18 +68,57 @@ private :
 	Host me;                    /** Local host descriptor */
 	RoutingTable routingTable;  /** DHT routing table */
 	Leafset leafset;            /** DHT leafset */
+	RcuPointer<RoutingState> state;  /** Published version of the above */
+	unsigned long generation;   /** Number of the published version */
+
+	/** A memoized next hop, valid for one version of the routing state. */
+	struct NextHopSlot
+	{
+		volatile int busy;
+		unsigned long generation;
+		Key key;
+		Host host;
+
+		NextHopSlot() : busy(0), generation(0) {}
+
+		/** Lookups never wait for a slot, they skip it when it is busy. */
+		bool TryLock() { return __sync_lock_test_and_set(&busy, 1) == 0; }
+		void Unlock() { __sync_lock_release(&busy); }
+	};
+
+	static const size_t NEXT_HOP_CACHE_SIZE = 256;
+	mutable NextHopSlot nextHopCache[NEXT_HOP_CACHE_SIZE];
+	mutable volatile unsigned long cacheHits;
+	mutable volatile unsigned long cacheMisses;
+
+	/** Hosts refused by full routing table cells, whose latency is unknown. */
+	std::vector<Host> candidates;
+	static const size_t MAX_CANDIDATES = 32;
+
+	/** Routing table rows in which a cell was emptied by a removal. */
+	std::vector<size_t> emptiedRows;
+
+	/** Publish the current leafset and routing table. Mutex is locked. */
+	void Publish();
+
+	/** Add a host in the routing structures. Mutex is locked. */
+	bool addHost(const Host& host);
+
+	/** Finds the next routing destination in a routing state. */
+	Host lookup(const RoutingState& current, const Key& key) const;
 
 public :
 	/** \brief Constructor
 	 *
 	 * Constructor, a new chimera routing system
 	 *
-	 * \param me the local node
+	 * \param _me the local node
+	 * \param leafset_size the number of hosts in the leafset
 	 */
-	Routing(Host me);
+	Routing(Host _me, size_t leafset_size = Leafset::DEFAULT_SIZE);
 
 	/** Change the id Key used on the network. */
-	void KeyUpdate(Host me);
+	void KeyUpdate(Host _me);
 
 	/** \brief Updates the routing information by adding a peer.
 	 *
@@ -67,6 +130,13 @@ public :
 	 */
 	bool add(const Host& entry);
 
+	/** \brief Updates the routing information by adding several peers.
+	 *
+	 * \param entries  the peers that can be added
+	 * \return  true if at least one of them was added
+	 */
+	bool add(const std::vector<Host>& entries);
+
 	/** \brief Updates the routing information by removing a peer.
 	 *
 	 * When a peer leaves the network, this function removes it from the
@@ -77,6 +147,29 @@ public :
 	 */
 	bool remove(const Host& entry);
 
+	/** Refresh the link statistics copied in the routing table, and
+	 * publish them if one has changed. */
+	void UpdateStats();
+
+	/** Get the hosts to probe for proximity neighbour selection.
+	 *
+	 * They were refused by a full routing table cell, but their latency
+	 * wasn't known yet. Once it is measured, they may be added again.
+	 *
+	 * \return  the candidates, which are removed from the list
+	 */
+	std::vector<Host> TakeCandidates();
+
+	/** Get the routing table rows which need to be repaired.
+	 *
+	 * \return  the rows in which a cell was emptied by remove(), which
+	 *          are removed from the list
+	 */
+	std::vector<size_t> TakeEmptiedRows();
+
+	/** @return the average latency of the routing table entries */
+	double GetAverageLatency() const;
+
 	/** \brief Finds the next routing destination
 	 *
 	 * Finds the best destination for the next step of routing to key.
@@ -89,6 +182,24 @@ public :
 	 */
 	Host routeLookup(const Key& key) const;
 
+	/** \brief Finds the next hops to a key, for an iterative lookup.
+	 *
+	 * The first one is the routeLookup() result, the others are the known
+	 * hosts nearer to the key than me, the nearest first.
+	 *
+	 * \param key  routing destination
+	 * \param count  maximum number of hosts returned
+	 * \return  the hosts, none if I am the destination of the key
+	 */
+	std::vector<Host> nextHops(const Key& key, size_t count) const;
+
+	/** Get the next hop cache statistics.
+	 *
+	 * \param hits  set to the number of lookups answered by the cache
+	 * \param misses  set to the number of lookups which were computed
+	 */
+	void GetCacheStats(unsigned long* hits, unsigned long* misses) const;
+
 	/** Finds the row in the routing table
 	 *
 	 * @param key  key we're looking for
@@ -96,44 +207,57 @@ public :
 	 */
 	inline std::vector<Host>  rowLookup(const Key& key) const
 	{
-		BlockLockMutex lock(this);
-		size_t lineNum = this->me.GetKey().key_index(key);
-		return this->routingTable.getRow(lineNum);
+		RcuPointer<RoutingState>::Reader current(&this->state);
+		return current->routingTable.getRow(current->routingTable.getRowIndex(key));
+	}
+
+	/** Returns a row of the routing table, and me */
+	inline std::vector<Host> getRow(size_t row) const
+	{
+		RcuPointer<RoutingState>::Reader current(&this->state);
+		return current->routingTable.getRow(row);
+	}
+
+	/** @return the length, in digits, of the prefix shared by key and me */
+	inline size_t getRowIndex(const Key& key) const
+	{
+		RcuPointer<RoutingState>::Reader current(&this->state);
+		return current->routingTable.getRowIndex(key);
 	}
 
 	/** Returns all the entries in the leafset */
 	inline std::vector<Host> getLeafset() const
 	{
-		BlockLockMutex lock(this);
-		return this->leafset.getCopy();
+		RcuPointer<RoutingState>::Reader current(&this->state);
+		return current->leafset.getCopy();
 	}
 
 	/** Returns clockwise entries in the leafset */
 	inline std::vector<Host> getCWLeafset() const
 	{
-		BlockLockMutex lock(this);
-		return this->leafset.getCWSide();
+		RcuPointer<RoutingState>::Reader current(&this->state);
+		return current->leafset.getCWSide();
 	}
 
 	/** Returns counter-clockwise entries in the leafset */
 	inline std::vector<Host> getCCWLeafset() const
 	{
-		BlockLockMutex lock(this);
-		return this->leafset.getCCWSide();
+		RcuPointer<RoutingState>::Reader current(&this->state);
+		return current->leafset.getCCWSide();
 	}
 
 	/** Returns all the entries in the routing table */
 	inline std::vector<Host> getRoutingTable() const
 	{
-		BlockLockMutex lock(this);
-		return this->routingTable.getCopy();
+		RcuPointer<RoutingState>::Reader current(&this->state);
+		return current->routingTable.getCopy();
 	}
 
-	/** @return the leafset */
-	const Leafset* GetLeafset() const;
+	/** @return a copy of the published leafset */
+	Leafset GetLeafset() const;
 
-	/** @return the routing table */
-	const RoutingTable* GetRoutingTable() const;
+	/** @return a copy of the published routing table */
+	RoutingTable GetRoutingTable() const;
 
 };
 
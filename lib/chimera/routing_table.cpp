@@ -26,35 +26,144 @@
 #include <stdio.h>
 #include "routing_table.h"
 
-RoutingTable::RoutingTable(Host _me)
+template<size_t DIGIT_BITS, size_t ENTRIES>
+BasicRoutingTable<DIGIT_BITS, ENTRIES>::BasicRoutingTable(Host _me)
 	: me(_me),
-	  routing_table(MAX_ROW * MAX_COL * MAX_ENTRY)
+	  me_key(_me.GetKey()),
+	  rows(MAX_ROW, static_cast<Row*>(NULL))
 {
 	this->clear();
 }
 
-Host& RoutingTable::getEntry(size_t i, size_t j, size_t k)
+template<size_t DIGIT_BITS, size_t ENTRIES>
+BasicRoutingTable<DIGIT_BITS, ENTRIES>::BasicRoutingTable(const BasicRoutingTable& other)
+	: me(other.me),
+	  me_key(other.me_key),
+	  rows(other.rows)
 {
-	return routing_table.at(k * (MAX_COL * MAX_ROW) + j * (MAX_ROW) + i);
+	for (size_t i = 0; i < MAX_ROW; i++)
+		holdRow(rows[i]);
 }
 
-Host RoutingTable::getEntry(size_t i, size_t j, size_t k) const
+template<size_t DIGIT_BITS, size_t ENTRIES>
+BasicRoutingTable<DIGIT_BITS, ENTRIES>& BasicRoutingTable<DIGIT_BITS, ENTRIES>::operator=(const BasicRoutingTable& other)
 {
-	return routing_table.at(k * (MAX_COL * MAX_ROW) + j * (MAX_ROW) + i);
+	for (size_t i = 0; i < MAX_ROW; i++)
+	{
+		Row* row = holdRow(other.rows[i]);
+		releaseRow(rows[i]);
+		rows[i] = row;
+	}
+	this->me = other.me;
+	this->me_key = other.me_key;
+	return *this;
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+BasicRoutingTable<DIGIT_BITS, ENTRIES>::~BasicRoutingTable()
+{
+	for (size_t i = 0; i < MAX_ROW; i++)
+		releaseRow(rows[i]);
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+typename BasicRoutingTable<DIGIT_BITS, ENTRIES>::Row* BasicRoutingTable<DIGIT_BITS, ENTRIES>::holdRow(Row* row)
+{
+	__sync_fetch_and_add(&row->refs, 1);
+	return row;
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+void BasicRoutingTable<DIGIT_BITS, ENTRIES>::releaseRow(Row* row)
+{
+	if (row && __sync_sub_and_fetch(&row->refs, 1) == 0)
+		delete row;
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+typename BasicRoutingTable<DIGIT_BITS, ENTRIES>::Row& BasicRoutingTable<DIGIT_BITS, ENTRIES>::writeRow(size_t i)
+{
+	//an other table reads this row, it gets its own copy before the change
+	if (rows[i]->refs > 1)
+	{
+		Row* row = new Row(*rows[i]);
+		row->refs = 1;
+		releaseRow(rows[i]);
+		rows[i] = row;
+	}
+	return *rows[i];
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+void BasicRoutingTable<DIGIT_BITS, ENTRIES>::setEntry(size_t i, size_t j, size_t k, const Host& host)
+{
+	Row& row = writeRow(i);
+	Cell& cell = row.cells[j];
+	cell.keys[k] = host.GetKey();
+	cell.success_avg[k] = host.GetSuccessAvg();
+	cell.latency[k] = host.GetLatency();
+	row.hosts[j * MAX_ENTRY + k] = host;
+	//the entry is appended to the cell
+	if (k == cell.count)
+		cell.count++;
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+bool BasicRoutingTable<DIGIT_BITS, ENTRIES>::refreshEntry(size_t i, size_t j, size_t k)
+{
+	const Cell& cell = getCell(i, j);
+	const Host& host = getEntry(i, j, k);
+	float success_avg = host.GetSuccessAvg();
+	double latency = host.GetLatency();
+
+	//the row is only copied when a statistic has changed
+	if (!betterStats(success_avg, latency, cell.success_avg[k], cell.latency[k]) &&
+	    !betterStats(cell.success_avg[k], cell.latency[k], success_avg, latency))
+		return false;
+
+	Cell& changed = writeRow(i).cells[j];
+	changed.success_avg[k] = success_avg;
+	changed.latency[k] = latency;
+	return true;
 }
 
-void RoutingTable::setEntry(size_t i, size_t j, size_t k, Host host)
+template<size_t DIGIT_BITS, size_t ENTRIES>
+void BasicRoutingTable<DIGIT_BITS, ENTRIES>::removeEntry(size_t i, size_t j, size_t k)
 {
-	routing_table[k * (MAX_COL * MAX_ROW) + j * (MAX_ROW) + i] = host;
+	Row& row = writeRow(i);
+	Cell& cell = row.cells[j];
+	size_t first = j * MAX_ENTRY;
+	size_t last = cell.count - 1;
+
+	//keep the entries packed, the last one takes the free place
+	if (k != last)
+	{
+		cell.keys[k] = cell.keys[last];
+		cell.success_avg[k] = cell.success_avg[last];
+		cell.latency[k] = cell.latency[last];
+		row.hosts[first + k] = row.hosts[first + last];
+	}
+	row.hosts[first + last] = InvalidHost;
+	cell.count--;
 }
 
-void RoutingTable::clear()
+template<size_t DIGIT_BITS, size_t ENTRIES>
+void BasicRoutingTable<DIGIT_BITS, ENTRIES>::clear()
 {
-	for(std::vector<Host>::iterator it = routing_table.begin(); it != routing_table.end(); ++it)
-		*it = InvalidHost;
+	//the rows may be shared, new empty ones replace them
+	for (size_t i = 0; i < MAX_ROW; i++)
+	{
+		Row* row = new Row;
+		row->refs = 1;
+		for (size_t j = 0; j < MAX_COL; j++)
+			row->cells[j].count = 0;
+		releaseRow(rows[i]);
+		rows[i] = row;
+	}
 }
 
-std::string RoutingTable::GetStr() const
+template<size_t DIGIT_BITS, size_t ENTRIES>
+std::string BasicRoutingTable<DIGIT_BITS, ENTRIES>::GetStr() const
 {
 	size_t i, j, k;
 	bool new_line;
@@ -66,12 +175,12 @@ std::string RoutingTable::GetStr() const
 
 		for (j = 0; j < MAX_COL; j++)
 		{
-			for (k = 0; k < MAX_ENTRY; k++)
-				if (getEntry(i, j, k) != InvalidHost)
-				{
-					str += getEntry(i, j,k).GetKey().GetStr() + " ";
-					new_line = true;
-				}
+			const Cell& cell = getCell(i, j);
+			for (k = 0; k < cell.count; k++)
+			{
+				str += cell.keys[k].GetStr() + " ";
+				new_line = true;
+			}
 		}
 		if(new_line)
 			str += "\n";
@@ -81,186 +190,214 @@ std::string RoutingTable::GetStr() const
 }
 
 
-void RoutingTable::KeyUpdate(Host _me)
+template<size_t DIGIT_BITS, size_t ENTRIES>
+void BasicRoutingTable<DIGIT_BITS, ENTRIES>::KeyUpdate(Host _me)
 {
 	this->me = _me;
+	this->me_key = _me.GetKey();
 	//clear the routing table because when the key changes all the entries are at the wrong place
 	this->clear();
 }
 
-bool RoutingTable::add(const Host& entry)
+template<size_t DIGIT_BITS, size_t ENTRIES>
+bool BasicRoutingTable<DIGIT_BITS, ENTRIES>::add(const Host& entry, bool* refused)
 {
 	//original code performs some leafset update... shoud not be needed anymore
 	//TODO see if we can remove this sanity check
 	//the entry has the same key as the local node, should never happen
 	pf_log[W_DEBUG] << "Trying to add an entry in the routing table: " << entry;
-	if(this->me.GetKey() == entry.GetKey())
+	Key key = entry.GetKey();
+	if(this->me_key == key)
 	{
 		pf_log[W_DEBUG] << "Adding myself in the routing table ?";
 		return false;
 	}
 	//get the coordinates where the entry should go
-	size_t i = this->me.GetKey().key_index(entry.GetKey());
-	size_t j = hexalphaToInt(entry.GetKey().GetStr()[i]);
-	bool found = false;
-	for (size_t k = 0; !found && k < MAX_ENTRY; k++)
+	size_t i = getRowIndex(key);
+	size_t j = getDigit(key, i);
+	const Cell& cell = getCell(i, j);
+	for (size_t k = 0; k < cell.count; k++)
 	{
-		//we found an empty space, add the entry
-		if (this->getEntry(i, j, k) == InvalidHost)
-		{
-			pf_log[W_DEBUG] << "Entry added.";
-			this->setEntry(i, j, k, entry);
-			found = true;
-		}
-		//entry is already in the routing table, simply return
-		else if (this->getEntry(i, j, k) != InvalidHost && this->getEntry(i, j, k).GetKey() == entry.GetKey())
+		//entry is already in the routing table, refresh its statistics and return
+		if (cell.keys[k] == key)
 		{
 			pf_log[W_DEBUG] << "Entry already in the routing table.";
+			this->refreshEntry(i, j, k);
 			return false;
 		}
-
 	}
-	//the entry array is full we have to get rid of one
-	//replace the new node with the node with the highest latency in the entry array
-	//TODO understand why we can't just sometimes keep the entries we have
-	if (!found)
+	//we found an empty space, add the entry
+	if (cell.count < MAX_ENTRY)
+	{
+		pf_log[W_DEBUG] << "Entry added.";
+		this->setEntry(i, j, cell.count, entry);
+	}
+	//the entry array is full, replace the worst entry if the new one is better
+	else
 	{
 		size_t pick = this->findWorstEntry(i,j);
+		if (!betterStats(entry.GetSuccessAvg(), entry.GetLatency(),
+		                 cell.success_avg[pick], cell.latency[pick]))
+		{
+			if (refused)
+				*refused = true;
+			return false;
+		}
+		pf_log[W_DEBUG] << "Entry replaces " << this->getEntry(i, j, pick);
 		this->setEntry(i, j, pick, entry);
 	}
 	return true;
 }
 
-bool RoutingTable::remove(const Host& entry)
+template<size_t DIGIT_BITS, size_t ENTRIES>
+bool BasicRoutingTable<DIGIT_BITS, ENTRIES>::remove(const Host& entry, bool* emptied)
 {
 	//original code performs some leafset update... shoud not be needed anymore
 	//TODO see if we can remove this sanity check
 	//the entry has the same key as the local node, should never happen
 	pf_log[W_DEBUG] << "Trying to remove an entry from the routing table: " << entry;
-	if(this->me.GetKey() == entry.GetKey())
+	Key key = entry.GetKey();
+	if(this->me_key == key)
 	{
 		pf_log[W_DEBUG] << "Removing myself from the routing table ?";
 		return false;
 	}
 	//get the coordinates where the entry should go
-	size_t i = this->me.GetKey().key_index(entry.GetKey());
-	size_t j = hexalphaToInt(entry.GetKey().GetStr()[i]);
-	for (size_t k = 0; k < MAX_ENTRY; k++)
+	size_t i = getRowIndex(key);
+	size_t j = getDigit(key, i);
+	const Cell& cell = getCell(i, j);
+	for (size_t k = 0; k < cell.count; k++)
 	{
-		if (this->getEntry(i, j, k) != InvalidHost && this->getEntry(i, j, k).GetKey() == entry.GetKey())
+		if (cell.keys[k] == key)
 		{
 			pf_log[W_DEBUG] << "Entry removed";
-			//when we find it, set the entry to null so that we don't use it anymore
-			this->setEntry(i, j, k, InvalidHost);
+			//when we find it, drop the entry so that we don't use it anymore
+			this->removeEntry(i, j, k);
+			if (emptied)
+				*emptied = (getCell(i, j).count == 0);
 			return true;
 		}
 	}
 	return false;
 }
 
-size_t RoutingTable::findWorstEntry(size_t line, size_t column) const
+template<size_t DIGIT_BITS, size_t ENTRIES>
+bool BasicRoutingTable<DIGIT_BITS, ENTRIES>::UpdateStats()
 {
-	//TODO do a comparator for ChimeraHost instead ?
-	size_t worst = MAX_ENTRY;
-	for (size_t k = 0; k < MAX_ENTRY && this->getEntry(line, column, k) != InvalidHost; k++)
-	{
-		if(worst == MAX_ENTRY)
+	bool changed = false;
+	for (size_t i = 0; i < MAX_ROW; i++)
+		for (size_t j = 0; j < MAX_COL; j++)
+			for (size_t k = 0; k < getCell(i, j).count; k++)
+				if (this->refreshEntry(i, j, k))
+					changed = true;
+	return changed;
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+double BasicRoutingTable<DIGIT_BITS, ENTRIES>::GetAverageLatency() const
+{
+	double total = 0;
+	size_t nb = 0;
+	for (size_t i = 0; i < MAX_ROW; i++)
+		for (size_t j = 0; j < MAX_COL; j++)
 		{
-			worst = k;
+			const Cell& cell = getCell(i, j);
+			for (size_t k = 0; k < cell.count; k++)
+				if (cell.latency[k] > 0)
+				{
+					total += cell.latency[k];
+					nb++;
+				}
 		}
-		//priority is SuccessAvg > Latency
-		else if (this->getEntry(line, column, worst).GetSuccessAvg() > this->getEntry(line, column, k).GetSuccessAvg()
-			||
-			(
-				this->getEntry(line, column, worst).GetSuccessAvg() == this->getEntry(line, column, k).GetSuccessAvg()
-				&&
-				this->getEntry(line, column, worst).GetLatency() < this->getEntry(line, column, k).GetLatency()
-			)
-		)
-		{
+	return nb ? total / static_cast<double>(nb) : 0;
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+bool BasicRoutingTable<DIGIT_BITS, ENTRIES>::betterStats(float success_a, double latency_a, float success_b, double latency_b)
+{
+	//priority is SuccessAvg > Latency
+	if (success_a > success_b)
+		return true;
+	if (success_a < success_b)
+		return false;
+	if (latency_b <= 0)
+		return latency_a > 0;
+	return latency_a > 0 && latency_a < latency_b;
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+bool BasicRoutingTable<DIGIT_BITS, ENTRIES>::betterEntry(const Cell& cell, size_t a, size_t b)
+{
+	return betterStats(cell.success_avg[a], cell.latency[a], cell.success_avg[b], cell.latency[b]);
+}
+
+template<size_t DIGIT_BITS, size_t ENTRIES>
+size_t BasicRoutingTable<DIGIT_BITS, ENTRIES>::findWorstEntry(size_t line, size_t column) const
+{
+	const Cell& cell = getCell(line, column);
+	size_t worst = MAX_ENTRY;
+	for (size_t k = 0; k < cell.count; k++)
+		if (worst == MAX_ENTRY || betterEntry(cell, worst, k))
 			worst = k;
-		}
-	}
 	return worst;
 }
 
-size_t RoutingTable::findBestEntry(size_t line, size_t column) const
+template<size_t DIGIT_BITS, size_t ENTRIES>
+size_t BasicRoutingTable<DIGIT_BITS, ENTRIES>::findBestEntry(size_t line, size_t column) const
 {
-	//TODO do a comparator for ChimeraHost instead ?
+	const Cell& cell = getCell(line, column);
 	size_t best = MAX_ENTRY;
-	for (size_t k = 0; k < MAX_ENTRY && this->getEntry(line, column, k) != InvalidHost; k++)
-	{
-		if(best == MAX_ENTRY)
-		{
-			best = k;
-		}
-		//priority is SuccessAvg > Latency
-		else if (this->getEntry(line, column, best).GetSuccessAvg() < this->getEntry(line, column, k).GetSuccessAvg()
-			||
-			(
-				this->getEntry(line, column, best).GetSuccessAvg() == this->getEntry(line, column, k).GetSuccessAvg()
-				&&
-				this->getEntry(line, column, best).GetLatency() > this->getEntry(line, column, k).GetLatency()
-			)
-		)
-		{
+	for (size_t k = 0; k < cell.count; k++)
+		if (best == MAX_ENTRY || betterEntry(cell, k, best))
 			best = k;
-		}
-	}
 	return best;
 }
 
-size_t RoutingTable::hexalphaToInt(int c)
+template<size_t DIGIT_BITS, size_t ENTRIES>
+size_t BasicRoutingTable<DIGIT_BITS, ENTRIES>::getRowIndex(const Key& key) const
 {
-	//ugly, see if we can change it or at least move it to Key class
-	char hexalpha[] = "0123456789abcdef";
-	size_t i;
-	size_t answer = 0;
-	for (i = 0; answer == 0 && hexalpha[i] != '\0'; i++)
-	{
-		if (hexalpha[i] == c)
-		{
-		    answer = i;
-		}
-	}
-	return answer;
+	size_t i = this->me_key.CommonPrefixBits(key) / DIGIT_BITS;
+	if (i >= MAX_ROW)
+		i = MAX_ROW - 1;
+	return i;
 }
 
-Host RoutingTable::routeLookup(const Key& key , bool* perfectMatch) const
+template<size_t DIGIT_BITS, size_t ENTRIES>
+Host BasicRoutingTable<DIGIT_BITS, ENTRIES>::routeLookup(const Key& key , bool* perfectMatch) const
 {
-	pf_log[W_DEBUG] << *this;
-	if(this->me.GetKey() == key)
+	if(this->me_key == key)
 	{
 		return this->me;
 	}
 	//try perfect match
-	size_t matchLine = this->me.GetKey().key_index(key);
-	size_t matchCol = hexalphaToInt(key.GetStr()[matchLine]);
-	Host nextHop = InvalidHost;
-	for (size_t k = 0; k < MAX_ENTRY; k++)
+	size_t matchLine = getRowIndex(key);
+	size_t matchCol = getDigit(key, matchLine);
+	const Cell& cell = getCell(matchLine, matchCol);
+	size_t nextHop = MAX_ENTRY;
+	size_t nextHopMatch = 0;
+	for (size_t k = 0; k < cell.count; k++)
 	{
-		if (this->getEntry(matchLine, matchCol, k) != InvalidHost && this->getEntry(matchLine, matchCol, k).GetSuccessAvg() > BAD_LINK)
+		if (cell.success_avg[k] <= BAD_LINK)
+			continue;
+		//priority : PrefixMatching > SuccessAvg > latency
+		size_t match = cell.keys[k].CommonPrefixBits(key) / DIGIT_BITS;
+		if (nextHop == MAX_ENTRY || match > nextHopMatch
+		    || (match == nextHopMatch && betterEntry(cell, k, nextHop)))
 		{
-			if(nextHop == InvalidHost)
-			{
-				nextHop = this->getEntry(matchLine, matchCol, k);
-			}
-			else
-			{
-				nextHop = bestEntry(nextHop, this->getEntry(matchLine, matchCol, k), key);
-			}
+			nextHop = k;
+			nextHopMatch = match;
 		}
 	}
-	if(nextHop != InvalidHost)
+	if(nextHop < MAX_ENTRY)
 	{
 		//we got a perfect match, prefix matching got one step further, we route to that peer
 		*perfectMatch = true;
-		return nextHop;
+		return this->getEntry(matchLine, matchCol, nextHop);
 	}
 	//no perfect match, fin the closest entry
 	*perfectMatch = false;
 	Host clockwiseBest = InvalidHost;
-	pf_log[W_DEBUG] << MAX_ROW << "x" << MAX_COL << "x" << MAX_ENTRY;
+	Key clockwiseKey;
 	size_t i = matchLine;
 	size_t j = matchCol;
 	while(clockwiseBest == InvalidHost)
@@ -271,18 +408,19 @@ Host RoutingTable::routeLookup(const Key& key , bool* perfectMatch) const
 		if(j >= MAX_COL)
 		{
 			clockwiseBest = this->me;
+			clockwiseKey = this->me_key;
 		}
 		else
 		{
 			//reached local node cell, move down to the next line
-			if(hexalphaToInt(this->me.GetKey().GetStr()[i])	== j)
+			if(getDigit(this->me_key, i) == j)
 			{
 				i++;
 				//if we were at the last line, can't go down any more, local node is the best candidate
 				if(i >= MAX_ROW)
 				{
-					pf_log[W_DEBUG] << "shit";
 					clockwiseBest = this->me;
+					clockwiseKey = this->me_key;
 				}
 				else
 				//we can go to the beginning of the next line
@@ -292,16 +430,18 @@ Host RoutingTable::routeLookup(const Key& key , bool* perfectMatch) const
 			}
 		}
 		//if we have a new position to try, do it
-		if(clockwiseBest != InvalidHost)
+		if(clockwiseBest == InvalidHost)
 		{
 			size_t index = this->findBestEntry(i,j);
 			if(index < MAX_ENTRY)
 			{
 				clockwiseBest = this->getEntry(i, j, index);
+				clockwiseKey = getCell(i, j).keys[index];
 			}
 		}
 	}
 	Host counterClockwiseBest = InvalidHost;
+	Key counterClockwiseKey;
 	i = matchLine;
 	j = matchCol;
 	while(counterClockwiseBest == InvalidHost)
@@ -311,18 +451,20 @@ Host RoutingTable::routeLookup(const Key& key , bool* perfectMatch) const
 		if(j == 0)
 		{
 			counterClockwiseBest = this->me;
+			counterClockwiseKey = this->me_key;
 		}
 		else
 		{
 			--j;
 			//reached local node cell, move down to the next line
-			if(hexalphaToInt(this->me.GetKey().GetStr()[i]) == j)
+			if(getDigit(this->me_key, i) == j)
 			{
 				i++;
 				//if we were at the last line, can't go down any more, local node is the best candidate
 				if(i == MAX_ROW)
 				{
 					counterClockwiseBest = this->me;
+					counterClockwiseKey = this->me_key;
 				}
 				else
 				//we can go to the beginning of the next line
@@ -332,17 +474,18 @@ Host RoutingTable::routeLookup(const Key& key , bool* perfectMatch) const
 			}
 		}
 		//if we have a new position to try, do it
-		if(clockwiseBest != InvalidHost)
+		if(counterClockwiseBest == InvalidHost)
 		{
 			size_t index = this->findBestEntry(i,j);
 			if(index < MAX_ENTRY)
 			{
 				counterClockwiseBest = this->getEntry(i, j, index);
+				counterClockwiseKey = getCell(i, j).keys[index];
 			}
 		}
 	}
-	Key distCW = clockwiseBest.GetKey().distance(key);
-	Key distCCW = counterClockwiseBest.GetKey().distance(key);
+	Key distCW = clockwiseKey.distance(key);
+	Key distCCW = counterClockwiseKey.distance(key);
 	if(distCW < distCCW)
 	{
 		return clockwiseBest;
@@ -361,29 +504,28 @@ Host RoutingTable::routeLookup(const Key& key , bool* perfectMatch) const
 	return InvalidHost;
 }
 
-std::vector<Host> RoutingTable::getRow(size_t i) const
+template<size_t DIGIT_BITS, size_t ENTRIES>
+std::vector<Host> BasicRoutingTable<DIGIT_BITS, ENTRIES>::getRow(size_t i) const
 {
 	std::vector<Host> ret;
 	size_t j, l;
 	//BlockLockMutex(this);
 	for (j = 0; j < MAX_COL; j++)
 	{
-		for (l = 0; l < MAX_ENTRY; l++)
+		for (l = 0; l < getCell(i, j).count; l++)
 		{
-			if (this->getEntry(i, j, l) != InvalidHost)
-			{
-				ret.insert(ret.end(), this->getEntry(i, j, l));
-			}
+			ret.insert(ret.end(), this->getEntry(i, j, l));
 		}
 	}
 	ret.insert(ret.end(), this->me);
 	return ret;
 }
 
-std::vector<Host> RoutingTable::getCopy() const
+template<size_t DIGIT_BITS, size_t ENTRIES>
+std::vector<Host> BasicRoutingTable<DIGIT_BITS, ENTRIES>::getCopy() const
 {
 	std::vector<Host> ret;
-	int i, j, l;
+	size_t i, j, l;
 
 	//BlockLockMutex(this);
 
@@ -391,12 +533,9 @@ std::vector<Host> RoutingTable::getCopy() const
 	{
 		for (j = 0; j < MAX_COL; j++)
 		{
-			for (l = 0; l < MAX_ENTRY; l++)
+			for (l = 0; l < getCell(i, j).count; l++)
 			{
-				if (this->getEntry(i, j, l) != InvalidHost)
-				{
-					ret.insert(ret.end(), this->getEntry(i, j, l));
-				}
+				ret.insert(ret.end(), this->getEntry(i, j, l));
 			}
 		}
 	}
@@ -404,31 +543,12 @@ std::vector<Host> RoutingTable::getCopy() const
 
 }
 
-Host RoutingTable::bestEntry(Host e1, Host e2)
-{
-	//priority : SuccessAvg > latency
-	if(e1.GetSuccessAvg() > e2.GetSuccessAvg() || ((e1.GetSuccessAvg() == e2.GetSuccessAvg()) && (e1.GetLatency() < e2.GetLatency())))
-	{
-		return e1;
-	}
-	else
-	{
-		return e2;
-	}
-}
+template class BasicRoutingTable<ROUTING_DIGIT_BITS, ROUTING_CELL_ENTRIES>;
 
-Host RoutingTable::bestEntry(Host e1, Host e2, const Key& key)
-{
-	//priority : PrefixMatching > SuccessAvg > latency
-	size_t e1match = e1.GetKey().key_index(key);
-	size_t e2match = e2.GetKey().key_index(key);
-	if(e1match > e2match)
-	{
-		return e1;
-	}
-	if(e2match > e1match)
-	{
-		return e2;
-	}
-	return bestEntry(e1,e2);
-}
+/* Other digit sizes, to compare them without rebuilding the library. */
+#if ROUTING_DIGIT_BITS != 2
+template class BasicRoutingTable<2, ROUTING_CELL_ENTRIES>;
+#endif
+#if ROUTING_DIGIT_BITS != 6
+template class BasicRoutingTable<6, ROUTING_CELL_ENTRIES>;
+#endif
@@ -29,25 +29,77 @@
 #include <net/hosts_list.h>
 #include <util/key.h>
 
-#define MAX_ROW KEY_SIZE/HEXA_BASE
-#define MAX_COL 16 /* 2^4 */
-#define MAX_ENTRY 3
-
 #include <vector>
 
+/** Number of key bits solved by each routing table line. */
+#ifndef ROUTING_DIGIT_BITS
+#define ROUTING_DIGIT_BITS 4
+#endif
+
+/** Number of hosts kept in each routing table cell. */
+#ifndef ROUTING_CELL_ENTRIES
+#define ROUTING_CELL_ENTRIES 3
+#endif
+
 /** Define the routing table of the DHT
  * Hosts are in added in the routing table if can't be added in the leafset
+ *
+ * Keys are split in digits of DIGIT_BITS bits. A line is the length of the
+ * prefix shared with the local node, and a column is the value of the next
+ * digit. Larger digits mean less hops but bigger tables.
  */
-class RoutingTable
+template<size_t DIGIT_BITS, size_t ENTRIES>
+class BasicRoutingTable
 {
+public:
+	/** Number of lines, the last digit may be shorter than the others. */
+	static const size_t MAX_ROW = (KEY_SIZE + DIGIT_BITS - 1) / DIGIT_BITS;
+	/** Number of columns */
+	static const size_t MAX_COL = 1 << DIGIT_BITS;
+	/** Number of entries in each cell */
+	static const size_t MAX_ENTRY = ENTRIES;
+
 private:
+	/** A routing table position.
+	 *
+	 * Keys and link statistics of the entries are copied here, so a
+	 * lookup reads a few contiguous bytes and never locks a Host.
+	 * Entries are kept packed at the beginning of the arrays.
+	 */
+	struct Cell
+	{
+		size_t count;                    /*!< Number of entries */
+		Key keys[ENTRIES];
+		float success_avg[ENTRIES];
+		double latency[ENTRIES];
+	};
+
+	/** A line of cells.
+	 *
+	 * Copies of the table share their rows, and a row is copied only
+	 * before it is changed, so a published copy of the table costs a
+	 * reference per row.
+	 */
+	struct Row
+	{
+		volatile size_t refs;            /*!< Tables sharing this row */
+		Cell cells[MAX_COL];
+		Host hosts[MAX_COL * ENTRIES];   /*!< Hosts of the cells entries */
+	};
+
 	Host me;                                 /*!< Local host descriptor */
-	std::vector<Host> routing_table;
+	Key me_key;                              /*!< Key of the local host */
+	std::vector<Row*> rows;                  /*!< MAX_ROW rows */
 
-	Host getEntry(size_t i, size_t j, size_t k) const;
-	Host& getEntry(size_t i, size_t j, size_t k);
-	void setEntry(size_t i, size_t j, size_t k, Host value);
+	const Cell& getCell(size_t i, size_t j) const { return rows[i]->cells[j]; }
+	const Host& getEntry(size_t i, size_t j, size_t k) const { return rows[i]->hosts[j * MAX_ENTRY + k]; }
+	Row& writeRow(size_t i);
+	void setEntry(size_t i, size_t j, size_t k, const Host& host);
+	bool refreshEntry(size_t i, size_t j, size_t k);
+	void removeEntry(size_t i, size_t j, size_t k);
 
+	static Row* holdRow(Row* row);
+	static void releaseRow(Row* row);
 
 public:
 	/*! \brief Constructor
@@ -56,7 +108,12 @@ public:
 	 *
 	 * \param me  the local node
 	 */
-	RoutingTable(Host me);
+	BasicRoutingTable(Host me);
+
+	/** The copy shares the rows of the table. */
+	BasicRoutingTable(const BasicRoutingTable& other);
+	BasicRoutingTable& operator=(const BasicRoutingTable& other);
+	~BasicRoutingTable();
 
 	/** @return a textual representation of the routing table. */
 	std::string GetStr() const;
@@ -71,21 +128,42 @@ public:
 
 	/*! \brief Add an entry to the routing table
 	 *
-	 * Adds en entry to the routing table
+	 * Adds en entry to the routing table. When its cell is full, the entry
+	 * replaces the worst one only if it is better, so cells keep the most
+	 * reliable and nearest hosts.
 	 *
 	 * \param entry  the entry that should be added
+	 * \param refused  if not NULL, set to true when the entry wasn't added
+	 *                 because its cell is full of better entries
 	 * \return  true if it was added, false if it wasn't
 	 */
-	bool add(const Host& entry);
+	bool add(const Host& entry, bool* refused = NULL);
 
 	/*! \brief Remove an entry from the routing table
 	 *
 	 * Remove an entry from the routing table
 	 *
 	 * \param entry  the entry that should be removed
+	 * \param emptied  if not NULL, set to true when the entry was the last
+	 *                 one of its cell
 	 * \return  true if it was removed, false if it wasn't
 	 */
-	bool remove(const Host& entry);
+	bool remove(const Host& entry, bool* emptied = NULL);
+
+	/*! \brief Refresh the link statistics of the entries
+	 *
+	 * The statistics used by lookups are a copy of the hosts ones,
+	 * taken when entries are added. This function copies them again.
+	 *
+	 * \return  true if a statistic has changed
+	 */
+	bool UpdateStats();
+
+	/*! \brief Average latency of the entries
+	 *
+	 * \return  the average of the known latencies, 0 if none is known
+	 */
+	double GetAverageLatency() const;
 
 	/*! \brief Finds the next routing destination
 	 *
@@ -100,6 +178,27 @@ public:
 	 */
 	Host routeLookup(const Key& key , bool* perfectMatch) const;
 
+	/*! \brief Get the routing table line of a key
+	 *
+	 * The line is the number of leading digits shared by the key and the
+	 * local node's key.
+	 *
+	 * \param key  the key
+	 * \return  the routing table line index
+	 */
+	size_t getRowIndex(const Key& key) const;
+
+	/*! \brief Get a digit of a key
+	 *
+	 * \param key  the key
+	 * \param i  index of the digit, 0 is the most significant one
+	 * \return  the routing table column index
+	 */
+	static size_t getDigit(const Key& key, size_t i)
+	{
+		return key.GetBits(i * DIGIT_BITS, DIGIT_BITS);
+	}
+
 	std::vector<Host>  getRow(size_t rowNum) const;
 
 	std::vector<Host>  getCopy() const;
@@ -120,7 +219,7 @@ private:
 	 *
 	 * \param line  routing table line index
 	 * \param column  routing table column index
-	 * \return  the index of the worst entry, -1 if all entries where NULL
+	 * \return  the index of the worst entry, MAX_ENTRY if the cell is empty
 	 */
 	size_t findWorstEntry(size_t line, size_t column) const;
 
@@ -132,46 +231,36 @@ private:
 	 *
 	 * \param line routing table line index
 	 * \param column routing table column index
-	 * \return the index of the best entry, -1 if all entries where NULL
+	 * \return the index of the best entry, MAX_ENTRY if the cell is empty
 	 */
 	size_t findBestEntry(size_t line, size_t column) const;
 
-	/*! \brief Transform a character from a dht key into an int
-	 *
-	 * The dht key is stored as a string, this function transforms a
-	 * character into an int in order to match an index in the routing
-	 * table.
-	 *
-	 * \param c  the character to translate
-	 * \return  the integer representation of the character
-	 */
-	static size_t hexalphaToInt(int c);
-
-	/*! \brief Compares 2 routing table entries and returns the best
+	/*! \brief Compares 2 entries of a cell
 	 *
-	 * Compares 2 routing table entries and returns the best based on
-	 * success average and latency.
+	 * The choice is made based first on success average and then on
+	 * latency.
 	 *
-	 * \param e1  the first entry to be compared
-	 * \param e2  the second entry to be compared
-	 * \return  the best entry between e1 and e2
+	 * \param cell  the routing table cell
+	 * \param a  index of the first entry
+	 * \param b  index of the second entry
+	 * \return  true if a is better than b
 	 */
-	static Host bestEntry(const Host e1, const Host e2);
+	static bool betterEntry(const Cell& cell, size_t a, size_t b);
 
-	/*! \brief Compares 2 routing table entries to route to a destination and returns the best
+	/*! \brief Compares the statistics of 2 hosts
 	 *
-	 * Compares 2 routing table entries and returns the best based on
-	 * prefix matching with the key, success average and latency.
+	 * A latency of 0 means that it was never measured, and is worse than
+	 * any measured one.
 	 *
-	 * \param e1 the first entry to be compared
-	 * \param e2 the second entry to be compared
-	 * \param key routing destination
-	 * \return the best entry between e1 and e2
+	 * \return  true if the first host is better than the second one
 	 */
-	static Host bestEntry(const Host e1, const Host e2, const Key& key);
+	static bool betterStats(float success_a, double latency_a, float success_b, double latency_b);
 
 };
 
+/** The routing table used by the DHT, configured at build time. */
+typedef BasicRoutingTable<ROUTING_DIGIT_BITS, ROUTING_CELL_ENTRIES> RoutingTable;
+
 template<>
 inline Log::flux& Log::flux::operator<< <RoutingTable> (RoutingTable routing_table)
 {
@@ -0,0 +1,50 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <util/pf_log.h>
+#include "snapshot_job.h"
+#include "chimera.h"
+#include "routing.h"
+
+bool SnapshotJob::Start()
+{
+	if (!loaded_.empty())
+	{
+		size_t removed = 0;
+		double now = time::dtime();
+		for (std::vector<Host>::iterator it = loaded_.begin(); it != loaded_.end(); ++it)
+		{
+			if (it->GetLastHeard() >= load_time_)
+				continue;
+
+			it->SetFailureTime(now);
+			if (routing_->remove(*it))
+				removed++;
+		}
+		pf_log[W_ROUTING] << "Snapshot: " << removed << " of " << loaded_.size()
+		                  << " hosts didn't answer and were removed";
+		loaded_.clear();
+	}
+
+	chimera_->SaveSnapshot();
+	return true;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef SNAPSHOT_JOB_H
+#define SNAPSHOT_JOB_H
+#include <vector>
+#include <net/host.h>
+#include <net/network.h>
+#include <scheduler/job.h>
+#include <util/time.h>
+
+class Chimera;
+class Routing;
+
+/** Snapshot of the routing infrastructure, for warm restarts.
+ *
+ * The first run happens once the pings sent to the hosts loaded from the
+ * snapshot are answered or given up, and removes the hosts which didn't
+ * answer. Each run then saves the snapshot.
+ */
+class SnapshotJob : public Job
+{
+	Chimera* chimera_;
+	Routing* routing_;
+	std::vector<Host> loaded_;
+	double load_time_;
+
+	bool Start();
+
+public:
+
+	static const double PERIOD = 60.0;  /**< Seconds between two saves */
+
+	SnapshotJob(Chimera* chimera, Routing* routing, const std::vector<Host>& loaded)
+		: Job(time::dtime() + Network::MAX_RETRY * Network::RETRANSMIT_INTERVAL + 1,
+		      REPEAT_PERIODIC, PERIOD),
+		  chimera_(chimera),
+		  routing_(routing),
+		  loaded_(loaded),
+		  load_time_(time::dtime())
+	{
+		SetPriority(PRIORITY_LOW);
+	}
+};
+
+#endif /* SNAPSHOT_JOB_H */
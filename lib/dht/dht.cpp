@@ -133,7 +133,7 @@ void DHT::Unpublish(const Key& id, Data* data) const
 	}
 }
 
-bool DHT::RequestData(const Key& id) const
+bool DHT::RequestData(const Key& id, LookupMode mode) const
 {
 	if(storage_->hasKey(id))
 	{
@@ -145,7 +145,8 @@ bool DHT::RequestData(const Key& id) const
 	Packet pckt(DHTGetType, me_, id);
 	pckt.SetArg(DHT_GET_KEY, id);
 
-	if(!chimera_->Route(pckt))
+	bool sent = (mode == ITERATIVE) ? chimera_->Lookup(pckt) : chimera_->Route(pckt);
+	if(!sent)
 	{
 		pf_log[W_DHT] << "I'm the owner of the data, and no data is present.";
 		return false;
@@ -46,6 +46,13 @@ public:
 	 */
 	static const uint32_t REDONDANCY = 1;
 
+	/** How a request finds the owner of its key. */
+	enum LookupMode
+	{
+		RECURSIVE,   /**< Forwarded hop by hop, see Chimera::Route() */
+		ITERATIVE    /**< Next hops queried in parallel, see Chimera::Lookup() */
+	};
+
 	/* DHT constructor.
 	 * @param port the port that we listen on
 	 * @param me the key used on the routing layer
@@ -85,8 +92,9 @@ public:
 	 * @return true if a request need to be sent, false otherwise.
 	 * If false is returned, it does not mean that the data is available,
 	 * because the data may just not exist.
+	 * @param mode  how the owner of the key is found
 	 */
-	bool RequestData(const Key& id) const;
+	bool RequestData(const Key& id, LookupMode mode = RECURSIVE) const;
 
 	/** Handle a network message.
 	 * @return true if the request was send successfully, false otherwise. */
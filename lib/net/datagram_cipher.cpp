@@ -0,0 +1,165 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <string.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <util/pf_log.h>
+#include "packet.h"
+#include "datagram_cipher.h"
+
+DatagramCipher::DatagramCipher(const std::string& _secret)
+	: Mutex(RECURSIVE_MUTEX),
+	secret(_secret)
+{
+}
+
+DatagramCipher::~DatagramCipher()
+{
+	ClearSessions();
+}
+
+void DatagramCipher::ClearSessions()
+{
+	for(SessionMap::iterator it = sessions.begin(); it != sessions.end(); ++it)
+	{
+		EVP_CIPHER_CTX_free(it->second.enc);
+		EVP_CIPHER_CTX_free(it->second.dec);
+	}
+	sessions.clear();
+}
+
+DatagramCipher::session_t& DatagramCipher::GetSession(const Key& src, const Key& dst)
+{
+	/* The session is the same in both directions. */
+	std::pair<Key, Key> id = (src < dst) ? std::make_pair(src, dst) : std::make_pair(dst, src);
+
+	SessionMap::iterator it = sessions.find(id);
+	if(it != sessions.end())
+		return it->second;
+
+	if(sessions.size() >= MAX_SESSIONS)
+		ClearSessions();
+
+	/* session key = HMAC-SHA256(secret, lowest key | highest key) */
+	char ids[2 * Key::size];
+	unsigned char key[EVP_MAX_MD_SIZE];
+	unsigned int key_len = 0;
+
+	id.first.dump(ids);
+	id.second.dump(ids + Key::size);
+	if(!HMAC(EVP_sha256(), secret.data(), (int)secret.size(),
+	         (const unsigned char*)ids, sizeof ids, key, &key_len) || key_len < SESSION_KEY_SIZE)
+		throw CipherError();
+
+	session_t session;
+	session.enc = EVP_CIPHER_CTX_new();
+	session.dec = EVP_CIPHER_CTX_new();
+	if(!session.enc || !session.dec
+	   || !EVP_EncryptInit_ex(session.enc, EVP_aes_256_gcm(), NULL, key, NULL)
+	   || !EVP_DecryptInit_ex(session.dec, EVP_aes_256_gcm(), NULL, key, NULL))
+	{
+		EVP_CIPHER_CTX_free(session.enc);
+		EVP_CIPHER_CTX_free(session.dec);
+		memset(key, 0, sizeof key);
+		throw CipherError();
+	}
+	memset(key, 0, sizeof key);
+
+	pf_log[W_DEBUG] << "New datagram session between " << id.first << " and " << id.second;
+
+	return sessions.insert(std::make_pair(id, session)).first->second;
+}
+
+size_t DatagramCipher::Seal(char* buf, size_t len)
+{
+	BlockLockMutex lock(this);
+
+	size_t header_size = Packet::GetHeaderSize();
+	if(len < header_size)
+		return 0;
+
+	unsigned char* p = (unsigned char*)buf;
+	unsigned char* nonce = p + len;
+	unsigned char* tag = nonce + NONCE_SIZE;
+	int outl;
+
+	/* 96 random bits: the key is shared by several senders. */
+	if(RAND_bytes(nonce, NONCE_SIZE) != 1)
+		return 0;
+
+	try
+	{
+		EVP_CIPHER_CTX* ctx = GetSession(Key(buf), Key(buf + Key::size)).enc;
+
+		if(!EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, nonce)
+		   /* Header is authenticated, not encrypted */
+		   || !EVP_EncryptUpdate(ctx, NULL, &outl, p, (int)header_size)
+		   || !EVP_EncryptUpdate(ctx, p + header_size, &outl, p + header_size, (int)(len - header_size))
+		   || !EVP_EncryptFinal_ex(ctx, p + len, &outl)
+		   || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag))
+			return 0;
+	}
+	catch(CipherError &e)
+	{
+		pf_log[W_ERR] << "DatagramCipher: unable to initialize session";
+		return 0;
+	}
+
+	return len + OVERHEAD;
+}
+
+size_t DatagramCipher::Open(char* buf, size_t len)
+{
+	BlockLockMutex lock(this);
+
+	size_t header_size = Packet::GetHeaderSize();
+	if(len < header_size + OVERHEAD)
+		return 0;
+
+	len -= OVERHEAD;
+
+	unsigned char* p = (unsigned char*)buf;
+	unsigned char* nonce = p + len;
+	unsigned char* tag = nonce + NONCE_SIZE;
+	int outl;
+
+	try
+	{
+		EVP_CIPHER_CTX* ctx = GetSession(Key(buf), Key(buf + Key::size)).dec;
+
+		if(!EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, nonce)
+		   || !EVP_DecryptUpdate(ctx, NULL, &outl, p, (int)header_size)
+		   || !EVP_DecryptUpdate(ctx, p + header_size, &outl, p + header_size, (int)(len - header_size))
+		   || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag)
+		   || EVP_DecryptFinal_ex(ctx, p + len, &outl) <= 0)
+			return 0;
+	}
+	catch(CipherError &e)
+	{
+		pf_log[W_ERR] << "DatagramCipher: unable to initialize session";
+		return 0;
+	}
+
+	return len;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef DATAGRAM_CIPHER_H
+#define DATAGRAM_CIPHER_H
+
+#include <map>
+#include <string>
+#include <openssl/evp.h>
+
+#include <util/key.h>
+#include <util/mutex.h>
+
+/** Authenticated encryption of the UDP datagrams (AES-256-GCM).
+ *
+ * The packet header stays in clear, but is authenticated, and the data
+ * part is encrypted. A nonce and the authentication tag are appended
+ * at the end of the datagram:
+ *
+ * .----------.------------------.---------.--------.
+ * |  header  |  encrypted data  |  nonce  |  tag   |
+ * |          |                  | 12 oct  | 16 oct |
+ * '----------'------------------'---------'--------'
+ *
+ * A session key is derived from the network secret and the src/dst keys
+ * of the packet header, so both peers find it without any handshake. The
+ * same key is used in both directions and by every hop of a routed
+ * packet, so the nonce is drawn at random for each datagram: a counter
+ * would repeat between senders, or after a restart. The session key is
+ * computed once, and cached with its initialized cipher contexts, so
+ * sealing or opening a datagram does one pass on the buffer, in place,
+ * without any allocation.
+ */
+class DatagramCipher : protected Mutex
+{
+public:
+	static const size_t NONCE_SIZE = 12;
+	static const size_t TAG_SIZE = 16;
+	static const size_t SESSION_KEY_SIZE = 32;
+
+	/** Size added to each datagram */
+	static const size_t OVERHEAD = NONCE_SIZE + TAG_SIZE;
+
+	/** Maximum number of cached sessions */
+	static const size_t MAX_SESSIONS = 1024;
+
+	class CipherError : public std::exception {};
+
+	/** Constructor.
+	 *
+	 * @param secret  the secret shared by all the nodes of the network.
+	 */
+	DatagramCipher(const std::string& secret);
+	~DatagramCipher();
+
+	/** Encrypt a dumped packet in place.
+	 *
+	 * @param buf  the packet, as returned by Packet::DumpBuffer(OVERHEAD)
+	 * @param len  size of the packet
+	 * @return  the size of the datagram to send (len + OVERHEAD), or 0 on error.
+	 */
+	size_t Seal(char* buf, size_t len);
+
+	/** Check and decrypt a received datagram in place.
+	 *
+	 * @param buf  the received datagram
+	 * @param len  size of the datagram
+	 * @return  the size of the clear packet, or 0 if the datagram is forged or corrupted.
+	 */
+	size_t Open(char* buf, size_t len);
+
+private:
+	struct session_t
+	{
+		EVP_CIPHER_CTX* enc;
+		EVP_CIPHER_CTX* dec;
+	};
+	typedef std::map<std::pair<Key, Key>, session_t> SessionMap;
+	SessionMap sessions;
+
+	std::string secret;
+
+	/** Get the cached session for this pair of keys, or create it. */
+	session_t& GetSession(const Key& src, const Key& dst);
+
+	void ClearSessions();
+};
+
+#endif /* DATAGRAM_CIPHER_H */
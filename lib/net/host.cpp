@@ -47,6 +47,7 @@ class _Host
 
 	int failed;
 	double failuretime;
+	double lastheard;
 	double latency;
 	double loss;
 	double success;
@@ -75,12 +76,17 @@ public:
 	void SetKey(Key k) { addr.key = k; }
 
 	double GetFailureTime() const { return failuretime; }
+	double GetLastHeard() const { return lastheard; }
 
 	/** Update the latency with a weight of 10% */
 	void UpdateLatency(double l);
 	double GetLatency() const { return latency; }
 
 	void SetFailureTime(double f) { failuretime = f; }
+
+	/** Fill the success window to get this average */
+	void SetSuccessAvg(float avg);
+	void SetLastHeard(double t) { lastheard = t; }
 	float GetSuccessAvg() const { return success_avg; }
 
 };
@@ -90,6 +96,7 @@ _Host::_Host(Mutex* _mutex, const pf_addr& _addr)
 	addr(_addr),
 	failed(0),
 	failuretime(0),
+	lastheard(0),
 	latency(0),
 	loss(0),
 	success(0),
@@ -130,6 +137,21 @@ void _Host::UpdateStat (int success)
 	//  printf("Total: %f, avg: %f\n",total,this->success_avg);
 }
 
+void _Host::SetSuccessAvg (float avg)
+{
+	/* The window holds between none and SUCCESS_WINDOW successes. */
+	if (!(avg > 0))
+		avg = 0;
+	else if (avg > 1)
+		avg = 1;
+
+	int successes = (int) (avg * SUCCESS_WINDOW + 0.5);
+	for (int i = 0; i < SUCCESS_WINDOW; i++)
+		this->success_win[i] = (i < successes) ? 1 : 0;
+	this->success_win_index = successes;
+	this->success_avg = (float) successes / SUCCESS_WINDOW;
+}
+
 void _Host::UpdateLatency (const double l)
 {
 	if(l < 0.0)
@@ -263,6 +285,22 @@ double Host::GetFailureTime() const
 	return host->GetFailureTime();
 }
 
+double Host::GetLastHeard() const
+{
+	if(this->host == NULL) return 0.0;
+
+	BlockLockMutex lock(this->host->GetMutex());
+	return host->GetLastHeard();
+}
+
+void Host::SetLastHeard(const double t)
+{
+	if(this->host == NULL) return;
+
+	BlockLockMutex lock(this->host->GetMutex());
+	host->SetLastHeard(t);
+}
+
 void Host::UpdateLatency(const double l)
 {
 	if(this->host == NULL) return;
@@ -291,10 +329,18 @@ float Host::GetSuccessAvg() const
 {
 	if(this->host == NULL) return 0.0;
 
-	BlockLockMutex(this->host->GetMutex());
+	BlockLockMutex lock(this->host->GetMutex());
 	return host->GetSuccessAvg();
 }
 
+void Host::SetSuccessAvg(const float avg)
+{
+	if(this->host == NULL) return;
+
+	BlockLockMutex lock(this->host->GetMutex());
+	host->SetSuccessAvg(avg);
+}
+
 unsigned int Host::GetReference() const
 {
 	if(this->host == NULL) return 0;
@@ -123,10 +123,14 @@ public:
 	double GetFailureTime() const;        /**< Get the failure time */
 	void SetFailureTime(const double f);  /**< Set the failure time */
 
+	double GetLastHeard() const;          /**< Get the time of the last packet received from it */
+	void SetLastHeard(const double t);    /**< Set the time of the last packet received from it */
+
 	double GetLatency() const;            /**< Get the latency */
 	void UpdateLatency(const double l);   /**< Update the latency with a weight of 10% */
 
 	float GetSuccessAvg() const;          /**< Get the success average */
+	void SetSuccessAvg(const float avg);  /**< Restore a success average, e.g. from a snapshot, clamped to [0,1] */
 
 	/** \brief Get the reference count.
 	 *
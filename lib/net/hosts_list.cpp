@@ -71,6 +71,10 @@ Host HostsList::GetHost(const pf_addr& address)
 		it = hosts.insert(std::pair<pf_addr, Host>(address, Host(this, address))).first;
 		pf_log[W_ROUTING] << "added";
 	}
+	/* A host created from its address only, like a bootstrap peer,
+	 * gets its key from the first address which has it. */
+	else if(!it->second.GetKey() && address.key)
+		it->second.SetKey(address.key);
 
 	pf_log[W_ROUTING] << "host entries:";
 	for(HostMap::iterator free_it = hosts.begin();
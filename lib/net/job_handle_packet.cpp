@@ -21,6 +21,7 @@
  */
 
 #include "job_handle_packet.h"
+#include "packet_handler.h"
 
 bool HandlePacketJob::Start()
 {
@@ -33,4 +34,41 @@ HandlePacketJob::HandlePacketJob(Chimera *chimera, const Host& sender, const Pac
 		chimera_(chimera),
 		sender_(sender),
 		pckt_(pckt)
-{}
+{
+	Init();
+}
+
+HandlePacketJob::HandlePacketJob(Chimera *chimera, const Host& sender, Packet* pckt)
+	: Job(0.0, REPEAT_NONE),
+		chimera_(chimera),
+		sender_(sender)
+{
+	pckt_.Swap(*pckt);
+	Init();
+}
+
+void HandlePacketJob::Init()
+{
+	PacketHandlerBase* handler = pckt_.GetPacketType().GetHandler();
+	if(!handler)
+		return;
+
+	switch(handler->getType())
+	{
+		/* Routing and leafset maintenance must not wait behind bulk traffic. */
+		case HANDLER_TYPE_CHIMERA:
+			SetPriority(PRIORITY_HIGH);
+			break;
+		/* Messages about the same key are handled in order, one at a time. */
+		case HANDLER_TYPE_DHT:
+			SetAffinity(pckt_.GetDst());
+			break;
+		case HANDLER_TYPE_ARBORE:
+			SetPriority(PRIORITY_LOW);
+			SetAffinity(pckt_.GetDst());
+			break;
+		/* Other handlers keep the normal priority, on any lane. */
+		default:
+			break;
+	}
+}
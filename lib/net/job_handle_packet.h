@@ -24,6 +24,7 @@
 #define HANDLEPACKETJOB_H
 
 #include <scheduler/job.h>
+#include <util/pool.h>
 
 #include "host.h"
 #include "packet.h"
@@ -35,18 +36,27 @@
  * this job is used to ask a scheduler thread to call the
  * packet handler.
  */
-class HandlePacketJob : public Job
+class HandlePacketJob : public Job, public Pooled<HandlePacketJob>
 {
 	Chimera *chimera_;
 	Host sender_;
 	Packet pckt_;
 
 	bool Start();
+	void Init();
 
 public:
 	HandlePacketJob(Chimera        *chimera,
 	                const Host&     sender,
 	                const Packet&   pckt);
+
+	/** Build the job by taking the content of the packet, without copying it.
+	 *
+	 * @param pckt  the packet, which is left empty.
+	 */
+	HandlePacketJob(Chimera        *chimera,
+	                const Host&     sender,
+	                Packet*         pckt);
 };
 
 #endif // HANDLEPACKETJOB_H
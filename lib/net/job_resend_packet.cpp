@@ -20,32 +20,72 @@
  *
  */
 
+#include <chimera/chimera.h>
+#include <util/pf_log.h>
 #include <util/time.h>
 #include "network.h"
-
 #include "job_resend_packet.h"
 
 bool ResendPacketJob::Start()
 {
+	if(chimera)
+	{
+		/* The next hop didn't acknowledge the routed packet in time. */
+		tried.push_back(desthost);
+
+		Host next = chimera->GetRouteCandidate(packet, tried);
+		if(next)
+		{
+			pf_log[W_ROUTING] << "No ACK from " << desthost << ", rerouting through " << next;
+			desthost.UpdateStat(0);
+
+			/* The network thread reads them when the ACK comes. */
+			BlockLockMutex lock(network);
+			desthost = next;
+			transmittime = time::dtime();
+			SetRepeatDelta(GetInterval(desthost, true));
+		}
+	}
+
 	if(!network->Send(sock, desthost, packet))
+	{
+		network->ForgetResend(this);
 		return false;
+	}
 	retry++;
 	if(retry < Network::MAX_RETRY)
 		return true;
 
 	desthost.UpdateStat(0);
+	network->ForgetResend(this);
 	return false;
 }
 
-ResendPacketJob::ResendPacketJob(Network* _network, int _sock, const Host& _desthost, const Packet& _packet, double transmit_time)
-	: Job(time::dtime() + Network::RETRANSMIT_INTERVAL, REPEAT_PERIODIC, Network::RETRANSMIT_INTERVAL),
+double ResendPacketJob::GetInterval(const Host& host, bool routed)
+{
+	/* A latency of 0 was never measured. */
+	double interval = 4 * host.GetLatency();
+
+	if(!routed || interval <= 0 || interval > Network::RETRANSMIT_INTERVAL)
+		return Network::RETRANSMIT_INTERVAL;
+	if(interval < Network::MIN_RETRANSMIT_INTERVAL)
+		return Network::MIN_RETRANSMIT_INTERVAL;
+	return interval;
+}
+
+ResendPacketJob::ResendPacketJob(Network* _network, int _sock, const Host& _desthost, Packet* _packet,
+                                 double transmit_time, Chimera* _chimera)
+	: Job(transmit_time + GetInterval(_desthost, _chimera != NULL), REPEAT_PERIODIC,
+	      GetInterval(_desthost, _chimera != NULL)),
 		sock(_sock),
 		desthost(_desthost),
-		packet(_packet),
 		retry(0),
 		transmittime(transmit_time),
-		network(_network)
-{}
+		network(_network),
+		chimera(_chimera)
+{
+	packet.Swap(*_packet);
+}
 
 const Packet& ResendPacketJob::GetPacket() const
 {
@@ -23,19 +23,27 @@
 #ifndef RESENDPACKETJOB_H
 #define RESENDPACKETJOB_H
 
+#include <vector>
+
 #include <scheduler/job.h>
+#include <util/pool.h>
 
 #include "host.h"
 #include "packet.h"
 
+class Chimera;
 class Network;
 
 /** Resend a packet after a waited time.
  *
  * This job resend frequently a packet until
  * it receives an ACK message.
+ *
+ * A routed packet isn't sent again to a host which didn't acknowledge
+ * it, but to the next candidate of the route, after a delay depending
+ * on the host's latency.
  */
-class ResendPacketJob : public Job
+class ResendPacketJob : public Job, public Pooled<ResendPacketJob>
 {
 	int sock;
 	Host desthost;
@@ -43,16 +51,27 @@ class ResendPacketJob : public Job
 	unsigned int retry;
 	double transmittime;
 	Network* network;
+	Chimera* chimera;               /**< Reroutes the packet, NULL if it is not routed */
+	std::vector<Host> tried;        /**< Hosts which didn't acknowledge the routed packet */
 
 	bool Start();
 
+	/** @return the delay before the packet is sent again */
+	static double GetInterval(const Host& host, bool routed);
+
 public:
 
+	/** Build the job by taking the content of the packet, without copying it.
+	 *
+	 * @param _packet  the packet to resend, which is left empty.
+	 * @param _chimera  to send the packet to an other next hop, or NULL.
+	 */
 	ResendPacketJob(Network* _network,
 	                int _sock,
 	                const Host& _desthost,
-	                const Packet& _packet,
-	                double transmit_time);
+	                Packet* _packet,
+	                double transmit_time,
+	                Chimera* _chimera = NULL);
 
 	const Packet& GetPacket() const;
 	double GetTransmitTime() const;
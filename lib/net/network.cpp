@@ -38,27 +38,45 @@
 #include <util/pf_config.h>
 #include <util/pf_log.h>
 #include <util/pf_thread.h>
+#include <util/session_config.h>
 #include <util/tools.h>
 
 #include "packet.h"
+#include "datagram_cipher.h"
 #include "host.h"
 #include "hosts_list.h"
 #include "job_handle_packet.h"
 #include "job_resend_packet.h"
+#include "packet_waiter.h"
 #include "network.h"
 
 Network::Network(Chimera *chimera)
 	: Mutex(RECURSIVE_MUTEX),
 	highsock(-1),
 	seqend(0),
-	chimera_(chimera)
+	chimera_(chimera),
+	cipher(NULL)
 {
 	FD_ZERO(&socks_fd_set);
+
+	std::string secret;
+	if(session_cfg.Get("network_secret", secret) && !secret.empty())
+		EnableEncryption(secret);
 }
 
 Network::~Network()
 {
 	CloseAll();
+	delete cipher;
+}
+
+void Network::EnableEncryption(const std::string& secret)
+{
+	BlockLockMutex lock(this);
+
+	delete cipher;
+	cipher = new DatagramCipher(secret);
+	pf_log[W_INFO] << "Datagram encryption enabled";
 }
 
 int Network::Listen(uint16_t port, const char* bind_addr)
@@ -134,7 +152,7 @@ void Network::Loop()
 			if(!FD_ISSET(sock, &tmp_read_set))
 				continue;
 
-			static char data[PACKET_MAX_SIZE];
+			static char data[PACKET_MAX_SIZE + DatagramCipher::OVERHEAD];
 			struct sockaddr_in from;
 			ssize_t size;
 			socklen_t socklen = sizeof(from);
@@ -148,6 +166,17 @@ void Network::Loop()
 				return;
 			}
 
+			if(cipher)
+			{
+				size_t clear_size = cipher->Open(data, (size_t)size);
+				if(!clear_size)
+				{
+					pf_log[W_WARNING] << "Received a datagram which can't be authenticated, dropped";
+					return;
+				}
+				size = (ssize_t)clear_size;
+			}
+
 			if((size_t)size < Packet::GetHeaderSize())
 			{
 				pf_log[W_ERR] << "Received a packet too light "
@@ -161,8 +190,12 @@ void Network::Loop()
 				pf_addr address(from.sin_addr.s_addr, ntohs(from.sin_port));
 				Host sender = hosts_list.GetHost(address);
 
-				if(!sender.GetKey())
+				/* The source of a routed packet is its first sender, and
+				 * the source of an ACK the destination of the packet. */
+				if(!sender.GetKey() && !pckt.HasFlag(Packet::ACK) && !pckt.HasFlag(Packet::MUSTROUTE))
 					sender.SetKey(pckt.GetSrc());
+				/* Every packet, ACKs included, is a heartbeat. */
+				sender.SetLastHeard(time::dtime());
 
 				pf_log[W_PARSE] << "R(" << sender << ") - " << pckt;
 
@@ -171,6 +204,8 @@ void Network::Loop()
 					/* We got an ACK message, so we remove the ResendPacketJob, update
 					 * the latency information and mark this host as up.
 					 */
+					packet_waiters.Dispatch(pckt);
+
 					ResendPacketJob* job;
 					std::vector<ResendPacketJob*>::iterator it;
 					for(it = resend_list.begin();
@@ -203,7 +238,8 @@ void Network::Loop()
 					Send(sock, sender, ack);
 				}
 
-				scheduler_queue.Queue(new HandlePacketJob(chimera_, sender, pckt));
+				packet_waiters.Dispatch(pckt);
+				scheduler_queue.Queue(new HandlePacketJob(chimera_, sender, &pckt));
 			}
 			catch(Packet::Malformated &e)
 			{
@@ -251,7 +287,7 @@ void Network::StartNetwork(MyConfig* conf)
 #endif
 }
 
-bool Network::Send(int sock, Host host, Packet pckt)
+bool Network::Send(int sock, Host host, const Packet& pckt, bool reroute)
 {
 	struct sockaddr_in to;
 	ssize_t ret;
@@ -270,14 +306,22 @@ bool Network::Send(int sock, Host host, Packet pckt)
 	if(socks.find(sock) == socks.end())
 		return false;
 
-	if(!pckt.GetSeqNum())
-		pckt.SetSeqNum(this->seqend++);
+	/* Numbered and serialized, then given to the ResendPacketJob. */
+	Packet sent(pckt);
+	if(!sent.GetSeqNum())
+		sent.SetSeqNum(NextSeqNum());
 
+	pf_log[W_PARSE] << "S(" << host << ") - " << sent;
 
-	pf_log[W_PARSE] << "S(" << host << ") - " << pckt;
-
-	char* s = pckt.DumpBuffer();
-	ret = sendto (sock, s, pckt.GetSize(), 0, (struct sockaddr *) &to, sizeof (to));
+	char* s = sent.DumpBuffer(cipher ? DatagramCipher::OVERHEAD : 0);
+	size_t len = sent.GetSize();
+	if(cipher && !(len = cipher->Seal(s, len)))
+	{
+		pf_log[W_ERR] << "network_send: unable to encrypt packet";
+		free(s);
+		return false;
+	}
+	ret = sendto (sock, s, len, 0, (struct sockaddr *) &to, sizeof (to));
 	free(s);
 
 	if (ret < 0)
@@ -287,18 +331,19 @@ bool Network::Send(int sock, Host host, Packet pckt)
 		return false;
 	}
 
-	if (pckt.HasFlag(Packet::REQUESTACK))
+	if (sent.HasFlag(Packet::REQUESTACK))
 	{
 		std::vector<ResendPacketJob*>::iterator it;
 		for(it = resend_list.begin();
-		    it != resend_list.end() && (*it)->GetPacket().GetSeqNum() != pckt.GetSeqNum();
+		    it != resend_list.end() && (*it)->GetPacket().GetSeqNum() != sent.GetSeqNum();
 		    ++it)
 			;
 
 		if(it == resend_list.end())
 		{
 			/* There isn't any already existing job to retransmit this packet. */
-			ResendPacketJob* job = new ResendPacketJob(this, sock, host, pckt, start);
+			ResendPacketJob* job = new ResendPacketJob(this, sock, host, &sent, start,
+			                                           reroute ? chimera_ : NULL);
 			resend_list.push_back(job);
 			scheduler_queue.Queue(job);
 		}
@@ -307,3 +352,21 @@ bool Network::Send(int sock, Host host, Packet pckt)
 	return true;
 }
 
+void Network::ForgetResend(ResendPacketJob* job)
+{
+	BlockLockMutex lock(this);
+
+	std::vector<ResendPacketJob*>::iterator it = std::find(resend_list.begin(), resend_list.end(), job);
+	if(it != resend_list.end())
+		resend_list.erase(it);
+}
+
+uint32_t Network::NextSeqNum()
+{
+	BlockLockMutex lock(this);
+
+	/* 0 means that the packet has no sequence number yet. */
+	if(!++seqend)
+		++seqend;
+	return seqend;
+}
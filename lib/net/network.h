@@ -36,11 +36,13 @@
 
 class MyConfig;
 class ResendPacketJob;
+class DatagramCipher;
 
 class Network : public Thread, protected Mutex
 {
 public:
 	static const double RETRANSMIT_INTERVAL = 1.0; /**< Seconds before we try to retransmit a packet */
+	static const double MIN_RETRANSMIT_INTERVAL = 0.05; /**< Minimum retransmit delay of a routed packet, in seconds */
 	static const unsigned int MAX_RETRY = 3;       /**< Maximum tries before abording resend a packet */
 	static const size_t PACKET_MAX_SIZE = 1024;    /**< Maximum size for packets */
 
@@ -72,11 +74,16 @@ private:
 	std::vector<ResendPacketJob*> resend_list;
 	uint32_t seqend;
 	Chimera *chimera_;
+	DatagramCipher* cipher;  /**< Encryption of datagrams, NULL if disabled */
 
 	void CloseAll();
 	void Loop();
 	void OnStop();
 
+	friend class ResendPacketJob;
+	/** Remove a job which gives up from resend_list. */
+	void ForgetResend(ResendPacketJob* job);
+
 public:
 
 	/** Constructor of network.
@@ -94,16 +101,38 @@ public:
 	 */
 	int Listen(uint16_t port, const char* bind_addr);
 
+	/** Encrypt and authenticate all datagrams.
+	 *
+	 * Every node of the network must be configured with the same secret,
+	 * as clear datagrams are then dropped. It is called on creation when
+	 * the session configuration has a network_secret item, which can't
+	 * contain spaces.
+	 *
+	 * @param secret  the secret shared by the nodes.
+	 */
+	void EnableEncryption(const std::string& secret);
+
 	/* Read configuration and start listener, and connect to other servers */
 	virtual void StartNetwork(MyConfig* conf);
 
 	/** Send a packet.
 	 * @param sock the socket
 	 * @param host the Host which will receive the message
-	 * @param pckt the Packet to send
+	 * @param pckt the Packet to send, a copy of it is numbered, sent and kept
+	 *             for the retransmissions
+	 * @param reroute if the host doesn't acknowledge a routed packet in time,
+	 *                send it to the next candidate of Chimera::GetRouteCandidate()
+	 *                instead of the same host again.
 	 * @return true if success, false otherwise
 	 */
-	bool Send(int sock, Host host, Packet pckt);
+	bool Send(int sock, Host host, const Packet& pckt, bool reroute = false);
+
+	/** Allocate a sequence number.
+	 *
+	 * Set it on a packet before sending it, for instance to wait for
+	 * its ACK with a PacketWaiter.
+	 */
+	uint32_t NextSeqNum();
 };
 
 #endif /* NETWORK_H */
@@ -20,6 +20,7 @@
  *
  */
 
+#include <algorithm>
 #include <cstdlib>
 
 #include <util/key.h>
@@ -50,6 +51,15 @@ Packet::Packet(const PacketType& _type, const Key& _src, const Key& _dst)
 {
 }
 
+Packet::Packet()
+			: type(0, NULL, 0, "NONE", T_END),
+			size(0),
+			flags(0),
+			seqnum(0),
+			data(NULL)
+{
+}
+
 Packet::Packet(const Packet& p)
 			: type(p.type),
 			size(p.size),
@@ -116,11 +126,11 @@ Packet::Packet(char* header, size_t datasize)
 	BuildArgsFromData();
 }
 
-char* Packet::DumpBuffer()
+char* Packet::DumpBuffer(size_t reserve)
 {
 	BuildDataFromArgs();
 
-	char* dump = (char*) malloc(GetSize());
+	char* dump = (char*) malloc(GetSize() + reserve);
 	uint32_t _type = htonl(type.GetType());
 	uint32_t _size = htonl(size);
 	uint32_t _seqnum = htonl(seqnum);
@@ -211,6 +221,18 @@ Packet::~Packet()
 		delete *it;
 }
 
+void Packet::Swap(Packet& p)
+{
+	arg_lst.swap(p.arg_lst);
+	type.Swap(p.type);
+	std::swap(size, p.size);
+	std::swap(src, p.src);
+	std::swap(dst, p.dst);
+	std::swap(flags, p.flags);
+	std::swap(seqnum, p.seqnum);
+	std::swap(data, p.data);
+}
+
 void Packet::BuildArgsFromData()
 {
 	if(!data)
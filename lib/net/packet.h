@@ -100,6 +100,9 @@ public:
 	 */
 	Packet(const PacketType& type, const Key& src = Key(), const Key& dst = Key());
 
+	/** Build an empty packet, for instance to Swap() it with another one. */
+	Packet();
+
 	/** Copy constructor.
 	 *
 	 * @param packet  the Packet object which is copied.
@@ -124,11 +127,20 @@ public:
 	/** Packet destructor */
 	~Packet();
 
+	/** Exchange the content of two packets, without copying it.
+	 *
+	 * @param packet  the Packet object which is exchanged with this one.
+	 */
+	void Swap(Packet& packet);
+
 	/** Get the data of the packet.
 	 *
 	 * You *must* free memory.
+	 *
+	 * @param reserve  number of free bytes to allocate after the packet,
+	 *                 for instance for the DatagramCipher trailer.
 	 */
-	char* DumpBuffer();
+	char* DumpBuffer(size_t reserve = 0);
 
 	/** Returns the header's size.
 	 *
@@ -20,6 +20,7 @@
  *
  */
 
+#include <algorithm>
 #include <cstdarg>
 
 #include "packet_handler.h"
@@ -78,3 +79,12 @@ PacketType::PacketType(const PacketType& pckt_type)
 	  def_flags(pckt_type.def_flags)
 {
 }
+
+void PacketType::Swap(PacketType& pckt_type)
+{
+	std::vector<PacketArgType>::swap(pckt_type);
+	std::swap(type, pckt_type.type);
+	name.swap(pckt_type.name);
+	std::swap(handler, pckt_type.handler);
+	std::swap(def_flags, pckt_type.def_flags);
+}
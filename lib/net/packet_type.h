@@ -44,11 +44,12 @@ enum
 	CHIMERA_UPDATE      = 3,
 	CHIMERA_PIGGY       = 4,
 	CHIMERA_JOIN_NACK   = 5,
+	CHIMERA_JOIN_STATE  = 6,
 	CIHMERA_PING        = 7,
 	CHIMERA_CHAT        = 8,
-	CHIMERA_RESERVED2   = 9,
-	CHIMERA_RESERVED3   = 10,
-	CHIMERA_RESERVED4   = 11,
+	CHIMERA_LOOKUP      = 9,
+	CHIMERA_LOOKUP_ACK  = 10,
+	CHIMERA_ROW_REQUEST = 11,
 
 	DHT_PUBLISH         = 12,
 	DHT_REPEAT_P        = 13,
@@ -98,6 +99,9 @@ public:
 	PacketType& operator=(const PacketType& pckt_type);
 	PacketType(const PacketType& pckt_type);
 
+	/** Exchange the content of two PacketType objects, without copying it. */
+	void Swap(PacketType& pckt_type);
+
 	uint32_t GetType() const { return type; }
 	std::string GetName() const { return name; }
 	PacketHandlerBase* GetHandler() const { return handler; }
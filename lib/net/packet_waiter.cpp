@@ -0,0 +1,166 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <scheduler/async_job.h>
+#include "packet_waiter.h"
+
+PacketWaiterList packet_waiters;
+
+PacketWaiter::PacketWaiter(AsyncJob* _job, const PacketType& _type, const Key& _src, const Key& _dst)
+	: job(_job),
+	  type(_type.GetType()),
+	  src(_src),
+	  dst(_dst),
+	  ack(false),
+	  seqnum(0)
+{
+	packet_waiters.Add(this);
+}
+
+PacketWaiter::PacketWaiter(AsyncJob* _job, uint32_t _seqnum)
+	: job(_job),
+	  type(0),
+	  ack(true),
+	  seqnum(_seqnum)
+{
+	packet_waiters.Add(this);
+}
+
+PacketWaiter::~PacketWaiter()
+{
+	packet_waiters.Remove(this);
+}
+
+bool PacketWaiter::Match(const Packet& pckt) const
+{
+	if(ack)
+		return pckt.HasFlag(Packet::ACK) && pckt.GetSeqNum() == seqnum;
+
+	if(pckt.HasFlag(Packet::ACK) || pckt.GetType() != type)
+		return false;
+
+	return (!src || pckt.GetSrc() == src) && (!dst || pckt.GetDst() == dst);
+}
+
+void PacketWaiter::Receive(const Packet& pckt)
+{
+	received.push_back(pckt);
+	job->Wake();
+}
+
+bool PacketWaiter::TakePacket(Packet* pckt)
+{
+	BlockLockMutex lock(&packet_waiters);
+	if(received.empty())
+		return false;
+
+	pckt->Swap(received.front());
+	received.pop_front();
+	return true;
+}
+
+bool PacketWaiter::HasPacket() const
+{
+	BlockLockMutex lock(&packet_waiters);
+	return !received.empty();
+}
+
+void PacketWaiter::Reset()
+{
+	BlockLockMutex lock(&packet_waiters);
+	received.clear();
+}
+
+PacketWaiterList::PacketWaiterList()
+	: count(0)
+{
+}
+
+void PacketWaiterList::Add(PacketWaiter* waiter)
+{
+	BlockLockMutex lock(this);
+
+	if(waiter->ack)
+		by_seqnum.insert(AckMap::value_type(waiter->seqnum, waiter));
+	else
+		by_type.insert(TypeMap::value_type(std::make_pair(waiter->type, waiter->src), waiter));
+	count++;
+}
+
+template<typename Map>
+void PacketWaiterList::Erase(Map& map, const typename Map::key_type& key, PacketWaiter* waiter)
+{
+	std::pair<typename Map::iterator, typename Map::iterator> range = map.equal_range(key);
+	for(typename Map::iterator it = range.first; it != range.second; ++it)
+		if(it->second == waiter)
+		{
+			map.erase(it);
+			count--;
+			return;
+		}
+}
+
+void PacketWaiterList::Remove(PacketWaiter* waiter)
+{
+	BlockLockMutex lock(this);
+
+	if(waiter->ack)
+		Erase(by_seqnum, waiter->seqnum, waiter);
+	else
+		Erase(by_type, std::make_pair(waiter->type, waiter->src), waiter);
+}
+
+template<typename Iterator>
+void PacketWaiterList::Dispatch(Iterator begin, Iterator end, const Packet& pckt)
+{
+	for(Iterator it = begin; it != end; ++it)
+		if(it->second->Match(pckt))
+			it->second->Receive(pckt);
+}
+
+void PacketWaiterList::Dispatch(const Packet& pckt)
+{
+	/* Most packets are awaited by nobody. */
+	if(!count)
+		return;
+
+	BlockLockMutex lock(this);
+
+	if(pckt.HasFlag(Packet::ACK))
+	{
+		std::pair<AckMap::iterator, AckMap::iterator> range = by_seqnum.equal_range(pckt.GetSeqNum());
+		Dispatch(range.first, range.second, pckt);
+		return;
+	}
+
+	std::pair<TypeMap::iterator, TypeMap::iterator> range;
+
+	/* Waiters of this sender, then waiters of any sender. */
+	range = by_type.equal_range(std::make_pair(pckt.GetType(), pckt.GetSrc()));
+	Dispatch(range.first, range.second, pckt);
+
+	if(pckt.GetSrc())
+	{
+		range = by_type.equal_range(std::make_pair(pckt.GetType(), Key()));
+		Dispatch(range.first, range.second, pckt);
+	}
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef PACKET_WAITER_H
+#define PACKET_WAITER_H
+
+#include <deque>
+#include <map>
+#include <utility>
+#include <stdint.h>
+
+#include <util/key.h>
+#include <util/mutex.h>
+#include "packet.h"
+
+class AsyncJob;
+
+/** Wake up an AsyncJob when a packet is received.
+ *
+ * The waiter is registered while it exists. The received packets are
+ * still given to their handlers as usual, the waiter only gets a copy.
+ */
+class PacketWaiter
+{
+	AsyncJob* job;
+	uint32_t type;
+	Key src;
+	Key dst;
+	bool ack;
+	uint32_t seqnum;
+
+	std::deque<Packet> received;     /**< Matching packets not taken yet, oldest first */
+
+	friend class PacketWaiterList;
+	bool Match(const Packet& pckt) const;
+	void Receive(const Packet& pckt);
+
+	PacketWaiter(const PacketWaiter&);
+	PacketWaiter& operator=(const PacketWaiter&);
+
+public:
+
+	/** Wait for a packet of a type.
+	 *
+	 * @param job  the job to wake up
+	 * @param type  type of the packet
+	 * @param src  key of the sender, or a null key for any sender
+	 * @param dst  key of the recipient, or a null key for any recipient
+	 */
+	PacketWaiter(AsyncJob* job, const PacketType& type, const Key& src = Key(), const Key& dst = Key());
+
+	/** Wait for the ACK of a packet sent with the REQUESTACK flag.
+	 *
+	 * @param job  the job to wake up
+	 * @param seqnum  sequence number of the sent packet
+	 */
+	PacketWaiter(AsyncJob* job, uint32_t seqnum);
+
+	~PacketWaiter();
+
+	/** Take the oldest matching packet not taken yet.
+	 *
+	 * Several packets can be received before the job runs, they are
+	 * queued so none of them is lost.
+	 *
+	 * @param pckt  filled with the packet, if any
+	 * @return  false if there is no packet left.
+	 */
+	bool TakePacket(Packet* pckt);
+
+	/** @return true if a matching packet is waiting to be taken */
+	bool HasPacket() const;
+
+	/** Forget the received packets, to wait for the next one. */
+	void Reset();
+};
+
+/** List of the registered PacketWaiter objects */
+class PacketWaiterList : public Mutex
+{
+	/** Waiters of a packet type, on the type and the sender (a null key for any sender) */
+	typedef std::multimap<std::pair<uint32_t, Key>, PacketWaiter*> TypeMap;
+	TypeMap by_type;
+
+	/** Waiters of an ACK, on the sequence number */
+	typedef std::multimap<uint32_t, PacketWaiter*> AckMap;
+	AckMap by_seqnum;
+
+	volatile size_t count;  /**< Number of waiters, readable without lock */
+
+	template<typename Map>
+	void Erase(Map& map, const typename Map::key_type& key, PacketWaiter* waiter);
+
+	template<typename Iterator>
+	void Dispatch(Iterator begin, Iterator end, const Packet& pckt);
+
+public:
+
+	PacketWaiterList();
+
+	void Add(PacketWaiter* waiter);
+	void Remove(PacketWaiter* waiter);
+
+	/** Give a received packet to the waiters which match it. */
+	void Dispatch(const Packet& pckt);
+};
+
+/* Singleton */
+extern PacketWaiterList packet_waiters;
+
+#endif /* PACKET_WAITER_H */
@@ -0,0 +1,171 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <util/pool.h>
+#include <util/time.h>
+#include "async_job.h"
+#include "job.h"
+#include "scheduler_queue.h"
+
+/** Run the next step of an AsyncJob */
+class ResumeAsyncJob : public Job, public Pooled<ResumeAsyncJob>
+{
+	AsyncJob* async_job;
+	unsigned int resume_id;
+	bool timeout;
+
+	bool Start()
+	{
+		async_job->Resume(resume_id, timeout);
+		return false;
+	}
+
+public:
+	ResumeAsyncJob(AsyncJob* _async_job, unsigned int _resume_id, double date, bool _timeout)
+		: Job(date, REPEAT_NONE),
+		  async_job(_async_job),
+		  resume_id(_resume_id),
+		  timeout(_timeout)
+	{}
+};
+
+AsyncJob::AsyncJob()
+	: step(0),
+	  id(0),
+	  waiting(false),
+	  pending_wake(false),
+	  timed_out(false),
+	  suspended(false),
+	  finished(false),
+	  running(false),
+	  refs(1)
+{
+}
+
+AsyncJob::~AsyncJob()
+{
+}
+
+void AsyncJob::Launch()
+{
+	BlockLockMutex lock(this);
+	Schedule(0.0, false);
+}
+
+void AsyncJob::Schedule(double date, bool timeout)
+{
+	refs++;
+	if(running)
+		deferred.push_back(std::make_pair(date, timeout));
+	else
+		scheduler_queue.Queue(new ResumeAsyncJob(this, id, date, timeout));
+}
+
+void AsyncJob::Resume(unsigned int resume_id, bool timeout)
+{
+	Lock();
+	refs--;
+
+	/* An other resumption of the same suspension has already been run. */
+	if(resume_id != id || finished)
+	{
+		bool del = finished && !refs;
+		Unlock();
+		if(del)
+			delete this;
+		return;
+	}
+
+	id++;
+	waiting = false;
+	timed_out = timeout;
+	suspended = false;
+	running = true;
+	Unlock();
+
+	Run(step);
+
+	Lock();
+	running = false;
+	for(size_t i = 0; i < deferred.size(); ++i)
+		scheduler_queue.Queue(new ResumeAsyncJob(this, id, deferred[i].first, deferred[i].second));
+	deferred.clear();
+
+	if(!suspended)
+		finished = true;
+	if(finished)
+		refs--;
+	bool del = finished && !refs;
+	Unlock();
+
+	if(del)
+		delete this;
+}
+
+void AsyncJob::SleepUntil(double date, int next_step)
+{
+	BlockLockMutex lock(this);
+	step = next_step;
+	suspended = true;
+	Schedule(date, false);
+}
+
+void AsyncJob::Wait(double timeout, int next_step)
+{
+	BlockLockMutex lock(this);
+	step = next_step;
+	suspended = true;
+
+	if(pending_wake)
+	{
+		pending_wake = false;
+		Schedule(0.0, false);
+		return;
+	}
+
+	waiting = true;
+	Schedule(timeout, true);
+}
+
+void AsyncJob::Finish()
+{
+	BlockLockMutex lock(this);
+	suspended = true;
+	finished = true;
+}
+
+void AsyncJob::Wake()
+{
+	BlockLockMutex lock(this);
+
+	if(finished)
+		return;
+
+	if(!waiting)
+	{
+		pending_wake = true;
+		return;
+	}
+
+	waiting = false;
+	Schedule(0.0, false);
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef ASYNC_JOB_H
+#define ASYNC_JOB_H
+
+#include <vector>
+#include <util/mutex.h>
+
+/** A job made of several steps, which waits between them without holding
+ * a Scheduler thread.
+ *
+ * Multi-step protocols (join, requests with retries...) are written as a
+ * linear sequence of steps in Run(). Each step ends by telling how the
+ * next one is started:
+ * - SleepUntil(): at a date;
+ * - Wait(): when an other thread calls Wake(), or at a timeout;
+ * - Finish(): never, the job is deleted.
+ *
+ * While the job waits, it isn't in any thread, so thousands of them can
+ * wait at the same time. Each step is run by a Scheduler thread.
+ *
+ * As with a condition variable, a step run after a Wait() has to check
+ * again what it was waiting for.
+ *
+ * @code
+ * void MyJob::Run(int step)
+ * {
+ *	switch(step)
+ *	{
+ *		case 0:
+ *			SendRequest();
+ *			Wait(time::dtime() + 5, 1);
+ *			break;
+ *		case 1:
+ *			if(TimedOut())
+ *				return Finish();
+ *			...
+ *	}
+ * }
+ * @endcode
+ */
+class AsyncJob : protected Mutex
+{
+	int step;              /**< Step to run at the next resumption */
+	unsigned int id;       /**< Identifier of the current suspension */
+	bool waiting;          /**< The job is suspended in Wait() */
+	bool pending_wake;     /**< Wake() has been called while not waiting */
+	bool timed_out;
+	bool suspended;        /**< The current step has called SleepUntil(), Wait() or Finish() */
+	bool finished;
+	bool running;          /**< A step is being run */
+	size_t refs;           /**< Pending resumptions, plus one until the job is finished */
+
+	/** Resumptions requested while a step is running. They are queued
+	 * when it returns, so two steps never run at the same time. */
+	std::vector<std::pair<double, bool> > deferred;
+
+	friend class ResumeAsyncJob;
+	void Resume(unsigned int resume_id, bool timeout);
+	void Schedule(double date, bool timeout);
+
+	AsyncJob(const AsyncJob&);
+	AsyncJob& operator=(const AsyncJob&);
+
+protected:
+
+	/** Run one step of the job.
+	 *
+	 * It must end by a call to SleepUntil(), Wait() or Finish(). If it
+	 * doesn't, the job is finished.
+	 *
+	 * @param step  the step given to the previous call, 0 the first time.
+	 */
+	virtual void Run(int step) = 0;
+
+	/** Run the next step at a date. Wake() doesn't interrupt it. */
+	void SleepUntil(double date, int next_step);
+
+	/** Run the next step when Wake() is called, or at a timeout.
+	 *
+	 * @param timeout  date, in time::dtime() format
+	 * @param next_step  step to run
+	 */
+	void Wait(double timeout, int next_step);
+
+	/** End the job. It is deleted once the current step returns and no
+	 * resumption is pending anymore.
+	 */
+	void Finish();
+
+	/** @return true if this step is run because a Wait() timed out. */
+	bool TimedOut() const { return timed_out; }
+
+	virtual ~AsyncJob();
+
+public:
+
+	AsyncJob();
+
+	/** Queue the first step of the job. */
+	void Launch();
+
+	/** Resume the job if it is in Wait(), or make its next Wait() return
+	 * immediately. It can be called by any thread.
+	 */
+	void Wake();
+};
+
+#endif /* ASYNC_JOB_H */
@@ -22,11 +22,18 @@
 
 #include <util/time.h>
 #include "job.h"
+#include "scheduler_queue.h"
 
 Job::Job(double start_at, repeat_type_t _repeat_type, double _repeat_delta)
  : start_time(start_at),
+   queue_time(0.0),
    repeat_type(_repeat_type),
-   repeat_delta(_repeat_delta)
+   repeat_delta(_repeat_delta),
+   priority(PRIORITY_NORMAL),
+   has_affinity(false),
+   affinity(0),
+   queue_index(SchedulerQueue::NOT_QUEUED),
+   queue_seq(0)
 {
 }
 
@@ -55,6 +62,16 @@ bool Job::DoStart()
 	return ret;
 }
 
+void Job::SetAffinity(const Key& key)
+{
+	const uint32_t* t = key.GetArray();
+
+	affinity = 0;
+	for(size_t i = 0; i < Key::nlen; ++i)
+		affinity ^= t[i];
+	has_affinity = true;
+}
+
 double Job::GetStartTime() const
 {
   return start_time;
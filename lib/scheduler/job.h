@@ -25,6 +25,8 @@
 #include <list>
 #include <time.h>
 #include <string>
+#include <stdint.h>
+#include <util/key.h>
 
 /** Base class for a Job, to be executed by a Scheduler */
 class Job
@@ -37,10 +39,30 @@ protected:
 		REPEAT_LESS_AND_LESS
 	} repeat_type_t;
 
+public:
+	/** Priority classes. Among the jobs which are due, the ones with a
+	 * higher priority are started first.
+	 */
+	typedef enum
+	{
+		PRIORITY_HIGH,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		PRIORITY_MAX
+	} priority_t;
+
 private:
 	double start_time;
+	double queue_time; /** Date the job was last queued */
 	repeat_type_t repeat_type; /** Repeat scheme */
 	double repeat_delta; /** Delta between each start */
+	priority_t priority;
+	bool has_affinity;
+	uint32_t affinity; /** Hash of the affinity key */
+
+	friend class SchedulerQueue;
+	size_t queue_index;  /** Position in the timer heap of the SchedulerQueue */
+	uint64_t queue_seq;  /** Queueing order, to start in FIFO order jobs with the same start time */
 
 protected:
 	/** Virtual protected function to be implemented by children class,
@@ -49,6 +71,21 @@ protected:
 	 */
 	virtual bool Start() = 0;
 
+	/** Change the delay before the next start of a repeated job. */
+	void SetRepeatDelta(double delta) { repeat_delta = delta; }
+
+	/** Set the priority class of the job. Call it before queueing the job. */
+	void SetPriority(priority_t _priority) { priority = _priority; }
+
+	/** Set the affinity key of the job.
+	 *
+	 * Jobs with the same affinity key, and the same priority, are started
+	 * in order, one at a time, by the same Scheduler thread. So their
+	 * handlers don't need to lock the state related to this key against
+	 * each other. Call it before queueing the job.
+	 */
+	void SetAffinity(const Key& key);
+
 public:
 	Job(double start_at, repeat_type_t _repeat_type, double _repeat_delta = 0.0);
 	virtual ~Job() {}
@@ -60,5 +97,12 @@ public:
 
 	/** @return the time when the job was started */
 	double GetStartTime() const;
+
+	/** @return the date the job was last put in the SchedulerQueue */
+	double GetQueueTime() const { return queue_time; }
+
+	priority_t GetPriority() const { return priority; }
+	bool HasAffinity() const { return has_affinity; }
+	uint32_t GetAffinity() const { return affinity; }
 };
 #endif						  /* JOB_H */
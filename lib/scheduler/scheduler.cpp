@@ -23,21 +23,44 @@
 
 #include <list>
 #include <algorithm>
-#include <unistd.h>
+#include <cstdlib>
 
 #include <util/time.h>
 #include <util/pf_log.h>
+#include <util/session_config.h>
 #include "job.h"
 #include "scheduler.h"
 #include "scheduler_queue.h"
+#include "scheduler_stats.h"
 
 std::vector<Scheduler*> Scheduler::schedulers;
 
 void Scheduler::StartSchedulers(size_t nb)
 {
+	if(schedulers.size() + nb > SchedulerQueue::MAX_LANES)
+	{
+		pf_log[W_WARNING] << "Can't start more than " << SchedulerQueue::MAX_LANES << " schedulers";
+		nb = SchedulerQueue::MAX_LANES - schedulers.size();
+	}
+
+	/* Threads waiting on the scheduler_queue must be stopped before it
+	 * is destroyed at exit.
+	 */
+	static bool registered = false;
+	if(!registered)
+	{
+		atexit(StopSchedulers);
+		registered = true;
+
+		double interval;
+		if(session_cfg.Get("scheduler_stats_interval", interval) && interval > 0)
+			scheduler_stats.StartDump(interval);
+	}
+
+	scheduler_queue.SetWorkers(schedulers.size() + nb);
 	for(size_t i = 0; i < nb; ++i)
 	{
-		Scheduler* scheduler = new Scheduler;
+		Scheduler* scheduler = new Scheduler(schedulers.size());
 		scheduler->Start();
 		schedulers.push_back(scheduler);
 	}
@@ -54,29 +77,36 @@ void Scheduler::StopSchedulers()
 	}
 
 	schedulers.clear();
+	scheduler_queue.SetWorkers(0);
 }
 
-// Check if a queued job needs to be started
+// Wait for a queued job and start it
 void Scheduler::Loop()
 {
-	usleep(100000);				  // every 0.1 sec
+	/* We remove job from queue before calling it, to prevent
+	 * crash if it tries to change queue list.
+	 */
+	Job* job = scheduler_queue.WaitJob(lane, this);
 
-	double now = time::dtime();
+	if(!job)				  /* We are stopped */
+		return;
 
-	while(scheduler_queue.GetQueueSize() != 0 && scheduler_queue.NextJobTime() < now)
-	{
-		/* We remove job from queue before calling it, to prevent
-		 * crash if it tries to change queue list.
-		 */
-		Job* job = scheduler_queue.PopJob();
+	const std::type_info& type = typeid(*job);
+	double start = time::dtime();
+	double wait = start - std::max(job->GetStartTime(), job->GetQueueTime());
 
-		if(job)				  /* The queue may have been emptied externaly */
-		{
-			pf_log[W_DEBUG] << "Begining handling job \"" << typeid(job).name() << "\". Queue_size:" <<scheduler_queue.GetQueueSize();
-			if(job->DoStart())
-				scheduler_queue.Queue(job);
-			else
-				delete job;
-		}
-	}
+	pf_log[W_DEBUG] << "Begining handling job \"" << type.name() << "\"";
+	bool repeat = job->DoStart();
+	scheduler_stats.Record(lane, type, wait, time::dtime() - start, repeat,
+	                       scheduler_queue.GetApproxQueueSize());
+
+	if(repeat)
+		scheduler_queue.Queue(job);
+	else
+		delete job;
+}
+
+void Scheduler::Interrupt()
+{
+	scheduler_queue.WakeUp();
 }
@@ -28,7 +28,8 @@
 #include <util/pf_thread.h>
 
 /** This class inherit from Thread and manage a static vector of instance of himself.
-  * Each instance will run regularly and run job located in the scheduler_queue.
+  * Each instance runs the jobs of its own lane of the scheduler_queue, steals
+  * jobs from the other lanes when idle, and sleeps until a job is due.
   * TODO: probably need to keep an instance of scheduler_queue rather than use a static
   * vector and a global variable.
   */
@@ -42,12 +43,17 @@ public:
 	static void StopSchedulers();
 
 private:
-	Scheduler() {}
+	Scheduler(size_t _lane) : lane(_lane) {}
 	~Scheduler() {}
 
+	size_t lane;      /**< Lane of the scheduler_queue this thread works on */
+
 	/** Internal run implementation of the Scheduler's thread */
 	void Loop();
 
+	/** Wake up the thread when it is stopped */
+	void Interrupt();
+
 	typedef std::vector<Scheduler*> SchedulerVector;
 	static SchedulerVector schedulers;
 };
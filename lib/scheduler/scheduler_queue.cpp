@@ -21,16 +21,26 @@
  */
 
 #include <algorithm>
+#include <cfloat>
 
 #include <util/mutex.h>
+#include <util/pf_thread.h>
 #include <util/pf_log.h>
+#include <util/time.h>
 #include "job.h"
 #include "scheduler_queue.h"
 
 SchedulerQueue scheduler_queue;
 
 SchedulerQueue::SchedulerQueue()
-  : Mutex(RECURSIVE_MUTEX)
+  : Mutex(RECURSIVE_MUTEX),
+    nb_lanes(1),
+    nb_workers(0),
+    next_lane(0),
+    nb_timers(0),
+    next_timer(DBL_MAX),
+    seq(0),
+    sleeping(0)
 {
 }
 
@@ -38,74 +48,434 @@ SchedulerQueue::~SchedulerQueue()
 {
 }
 
+bool SchedulerQueue::Before(const Job* a, const Job* b)
+{
+	if(a->GetStartTime() < b->GetStartTime())
+		return true;
+	if(b->GetStartTime() < a->GetStartTime())
+		return false;
+	return a->queue_seq < b->queue_seq;
+}
+
+void SchedulerQueue::HeapSet(size_t i, Job* job)
+{
+	timers[i] = job;
+	job->queue_index = i;
+}
+
+void SchedulerQueue::HeapUp(size_t i)
+{
+	Job* job = timers[i];
+	while(i > 0)
+	{
+		size_t parent = (i - 1) / 2;
+		if(!Before(job, timers[parent]))
+			break;
+		HeapSet(i, timers[parent]);
+		i = parent;
+	}
+	HeapSet(i, job);
+}
+
+void SchedulerQueue::HeapDown(size_t i)
+{
+	Job* job = timers[i];
+	size_t size = timers.size();
+	for(;;)
+	{
+		size_t child = 2 * i + 1;
+		if(child >= size)
+			break;
+		if(child + 1 < size && Before(timers[child + 1], timers[child]))
+			child++;
+		if(!Before(timers[child], job))
+			break;
+		HeapSet(i, timers[child]);
+		i = child;
+	}
+	HeapSet(i, job);
+}
+
+void SchedulerQueue::HeapRemove(size_t i)
+{
+	timers[i]->queue_index = NOT_QUEUED;
+
+	Job* last = timers.back();
+	timers.pop_back();
+	if(i == timers.size())
+		return;
+
+	HeapSet(i, last);
+	HeapUp(i);
+	HeapDown(last->queue_index);
+}
+
+void SchedulerQueue::UpdateNextTimer()
+{
+	next_timer = timers.empty() ? DBL_MAX : timers.front()->GetStartTime();
+	nb_timers = timers.size();
+}
+
+void SchedulerQueue::SetWorkers(size_t nb)
+{
+	BlockLockMutex lock(this);
+	if(nb > MAX_LANES)
+		nb = MAX_LANES;
+	nb_workers = nb;
+	if(nb > nb_lanes)
+		nb_lanes = nb;
+}
+
+void SchedulerQueue::PushLane(size_t l, Job* job)
+{
+	Lane& lane = lanes[l];
+	BlockLockMutex lane_lock(&lane);
+
+	job->queue_seq = lane.seq++;
+	lane.count++;
+	if(job->HasAffinity())
+		lane.bound[job->GetPriority()].push_back(job);
+	else
+		lane.free[job->GetPriority()].push_back(job);
+}
+
+Job* SchedulerQueue::TakeLane(size_t l, bool owner)
+{
+	Lane& lane = lanes[l];
+	BlockLockMutex lane_lock(&lane);
+
+	for(size_t p = 0; p < Job::PRIORITY_MAX; ++p)
+	{
+		JobFifo* fifo = &lane.free[p];
+		if(owner && !lane.bound[p].empty() &&
+		   (fifo->empty() || lane.bound[p].front()->queue_seq < fifo->front()->queue_seq))
+			fifo = &lane.bound[p];
+
+		if(fifo->empty())
+			continue;
+
+		Job* j = fifo->front();
+		fifo->pop_front();
+		lane.count--;
+		return j;
+	}
+	return NULL;
+}
+
+void SchedulerQueue::WakeLane(size_t l, bool bound)
+{
+	if(!lanes[l].asleep)
+	{
+		/* Only the owner of the lane can start a bound job. */
+		if(bound && l < nb_workers)
+			return;
+
+		for(l = 0; l < nb_lanes && !lanes[l].asleep; ++l)
+			;
+		if(l == nb_lanes)
+			return;
+	}
+
+	lanes[l].asleep = false;
+	sleeping--;
+	lanes[l].wakeup.Signal();
+}
+
 void SchedulerQueue::Queue(Job* job)
+{
+	pf_log[W_DEBUG] << "Queueing job \"" << typeid(*job).name() << "\"";
+
+	job->queue_time = time::dtime();
+	if(job->GetStartTime() <= job->queue_time)
+	{
+		/* Spread jobs over the lanes. The counter isn't protected, as
+		 * a wrong lane only costs a steal.
+		 */
+		size_t l;
+		bool bound = job->HasAffinity() && nb_workers > 0;
+		if(bound)
+			l = job->GetAffinity() % nb_workers;
+		else
+			l = next_lane++ % nb_lanes;
+
+		PushLane(l, job);
+
+		/* The lock of the lane orders this read after the sleeping
+		 * thread's increment, so a wakeup can't be lost.
+		 */
+		if(sleeping)
+		{
+			BlockLockMutex lock(this);
+			WakeLane(l, bound);
+		}
+		return;
+	}
+
+	BlockLockMutex lock(this);
+	job->queue_seq = seq++;
+	timers.push_back(job);
+	HeapUp(timers.size() - 1);
+
+	nb_timers = timers.size();
+
+	/* A thread may sleep until a later date. */
+	if(job->queue_index == 0)
+	{
+		UpdateNextTimer();
+		if(sleeping)
+			WakeLane(0, false);
+	}
+}
+
+Job* SchedulerQueue::PopTimer(double now, size_t l)
 {
 	BlockLockMutex lock(this);
-	pf_log[W_DEBUG] << "Queueing job \"" << typeid(job).name() << "\"";
 
-	for(JobList::iterator it = jobs.begin();
-		it != jobs.end();
-		++it)
+	while(!timers.empty() && timers.front()->GetStartTime() <= now)
 	{
-		if(job->GetStartTime() < (*it)->GetStartTime())
+		Job* j = timers.front();
+		HeapRemove(0);
+		UpdateNextTimer();
+
+		/* A bound job is handed over to the lane of its key, behind the
+		 * jobs with the same key which are already there.
+		 */
+		if(j->HasAffinity() && nb_workers > 0)
 		{
-			jobs.insert(it, job);
-			return;
+			size_t target = j->GetAffinity() % nb_workers;
+			PushLane(target, j);
+			WakeLane(target, true);
+			continue;
+		}
+
+		/* Let an other thread start the next one. */
+		if(sleeping && next_timer <= now)
+			WakeLane(l, false);
+		return j;
+	}
+	return NULL;
+}
+
+Job* SchedulerQueue::Steal(size_t l)
+{
+	size_t nb = nb_lanes;
+	for(size_t i = 1; i < nb; ++i)
+	{
+		size_t victim = (l + i) % nb;
+		Job* j = TakeLane(victim, victim >= nb_workers);
+		if(j)
+			return j;
+	}
+	return NULL;
+}
+
+bool SchedulerQueue::HasDueJob(double now, size_t l)
+{
+	if(!timers.empty() && timers.front()->GetStartTime() <= now)
+		return true;
+
+	for(size_t i = 0; i < nb_lanes; ++i)
+	{
+		BlockLockMutex lane_lock(&lanes[i]);
+		for(size_t p = 0; p < Job::PRIORITY_MAX; ++p)
+			if(!lanes[i].free[p].empty() ||
+			   ((i == l || i >= nb_workers) && !lanes[i].bound[p].empty()))
+				return true;
+	}
+	return false;
+}
+
+Job* SchedulerQueue::WaitJob(size_t l, Thread* thread)
+{
+	Lane& lane = lanes[l];
+
+	while(thread->IsRunning())
+	{
+		double now = time::dtime();
+		Job* job = NULL;
+
+		/* The shared timer heap is locked only when a job may be due. */
+		if(next_timer <= now)
+			job = PopTimer(now, l);
+		if(!job)
+			job = TakeLane(l, true);
+		if(!job)
+			job = Steal(l);
+		if(job)
+			return job;
+
+		/* Counted as sleeping before looking at the lanes again, so
+		 * Queue() either sees the counter or its job is seen here.
+		 */
+		BlockLockMutex lock(this);
+		sleeping++;
+		lane.asleep = true;
+		if(!thread->IsRunning() || HasDueJob(time::dtime(), l))
+		{
+			/* WakeLane() needs the lock, it can't have woken us up. */
+			lane.asleep = false;
+			sleeping--;
+			continue;
+		}
+
+		if(timers.empty())
+			lane.wakeup.Wait(*this);
+		else
+			lane.wakeup.TimedWait(*this, timers.front()->GetStartTime());
+
+		/* Not woken up by WakeLane() */
+		if(lane.asleep)
+		{
+			lane.asleep = false;
+			sleeping--;
 		}
 	}
 
-	jobs.push_back(job);
+	return NULL;
 }
 
-Job* SchedulerQueue::PopJob()
+void SchedulerQueue::WakeUp()
 {
 	BlockLockMutex lock(this);
-	if(jobs.size() == 0)
-		return NULL;
-	Job* j = jobs.front();
-	jobs.pop_front();
+	for(size_t l = 0; l < nb_lanes; ++l)
+		lanes[l].wakeup.Broadcast();
+}
+
+Job* SchedulerQueue::PopJob(double now)
+{
+	Job* j = PopTimer(now, 0);
+	for(size_t l = 0; !j && l < nb_lanes; ++l)
+		j = TakeLane(l, true);
 	return j;
 }
 
 void SchedulerQueue::Cancel(Job* job)
 {
 	BlockLockMutex lock(this);
-	JobList::iterator it = find(jobs.begin(), jobs.end(), job);
 
-	if(it == jobs.end())
+	/* The job may have been started, and even deleted, in the meantime,
+	 * so it is looked up by its address, and only read once found.
+	 */
+	JobHeap::iterator timer = find(timers.begin(), timers.end(), job);
+	if(timer != timers.end())
+	{
+		HeapRemove(static_cast<size_t>(timer - timers.begin()));
+		UpdateNextTimer();
+		delete job;
 		return;
+	}
+
+	for(size_t l = 0; l < nb_lanes; ++l)
+	{
+		Lane& lane = lanes[l];
+		BlockLockMutex lane_lock(&lane);
+
+		for(size_t p = 0; p < Job::PRIORITY_MAX; ++p)
+		{
+			JobFifo* fifos[] = { &lane.free[p], &lane.bound[p] };
+			for(size_t f = 0; f < 2; ++f)
+			{
+				JobFifo::iterator it = find(fifos[f]->begin(), fifos[f]->end(), job);
+				if(it == fifos[f]->end())
+					continue;
 
-	jobs.erase(it);
-	delete job;
+				fifos[f]->erase(it);
+				lane.count--;
+				delete job;
+				return;
+			}
+		}
+	}
 }
 
-void SchedulerQueue::CancelType(std::type_info type)
+static void CancelTypeInFifo(std::deque<Job*>& fifo, const std::type_info& type)
 {
-	BlockLockMutex lock(this);
-
-	JobList::iterator it = jobs.begin();
-	while(it != jobs.end())
+	std::deque<Job*>::iterator it = fifo.begin();
+	while(it != fifo.end())
 	{
-		if(typeid(*it) == type)
+		if(typeid(**it) == type)
 		{
 			delete *it;
-			it = jobs.erase(it);
+			it = fifo.erase(it);
 		}
 		else
 			++it;
 	}
 }
 
+void SchedulerQueue::CancelType(const std::type_info& type)
+{
+	BlockLockMutex lock(this);
+
+	for(size_t l = 0; l < nb_lanes; ++l)
+	{
+		BlockLockMutex lane_lock(&lanes[l]);
+		for(size_t p = 0; p < Job::PRIORITY_MAX; ++p)
+		{
+			CancelTypeInFifo(lanes[l].free[p], type);
+			CancelTypeInFifo(lanes[l].bound[p], type);
+		}
+
+		size_t count = 0;
+		for(size_t p = 0; p < Job::PRIORITY_MAX; ++p)
+			count += lanes[l].free[p].size() + lanes[l].bound[p].size();
+		lanes[l].count = count;
+	}
+
+	JobHeap kept;
+	for(JobHeap::iterator job = timers.begin(); job != timers.end(); ++job)
+	{
+		if(typeid(**job) == type)
+			delete *job;
+		else
+			kept.push_back(*job);
+	}
+
+	/* Rebuild the heap with the remaining jobs. */
+	timers.swap(kept);
+	for(size_t i = 0; i < timers.size(); ++i)
+		HeapSet(i, timers[i]);
+	for(size_t i = timers.size() / 2; i-- > 0;)
+		HeapDown(i);
+	UpdateNextTimer();
+}
+
 double SchedulerQueue::NextJobTime()
 {
 	BlockLockMutex lock(this);
-	if(jobs.size() == 0)
+	for(size_t l = 0; l < nb_lanes; ++l)
+	{
+		BlockLockMutex lane_lock(&lanes[l]);
+		for(size_t p = 0; p < Job::PRIORITY_MAX; ++p)
+		{
+			if(!lanes[l].free[p].empty())
+				return lanes[l].free[p].front()->GetStartTime();
+			if(!lanes[l].bound[p].empty())
+				return lanes[l].bound[p].front()->GetStartTime();
+		}
+	}
+	if(timers.empty())
 		return 0;
-	return jobs.front()->GetStartTime();
+	return timers.front()->GetStartTime();
 }
 
 size_t SchedulerQueue::GetQueueSize()
 {
 	BlockLockMutex lock(this);
-	return jobs.size();
+	size_t size = timers.size();
+	for(size_t l = 0; l < nb_lanes; ++l)
+	{
+		BlockLockMutex lane_lock(&lanes[l]);
+		for(size_t p = 0; p < Job::PRIORITY_MAX; ++p)
+			size += lanes[l].free[p].size() + lanes[l].bound[p].size();
+	}
+	return size;
+}
+
+size_t SchedulerQueue::GetApproxQueueSize() const
+{
+	size_t size = nb_timers;
+	for(size_t l = 0; l < nb_lanes; ++l)
+		size += lanes[l].count;
+	return size;
 }
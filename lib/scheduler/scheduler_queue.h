@@ -23,31 +23,85 @@
 
 #ifndef SCHEDULER_QUEUE_H
 #define SCHEDULER_QUEUE_H
-#include <list>
+#include <deque>
+#include <stdint.h>
+#include <vector>
 #include <typeinfo>
 
 #include <util/mutex.h>
+#include "job.h"
 
-class Job;
+class Thread;
 
-/** Queue of job, used by the Scheduler */
+/** Queue of job, used by the Scheduler.
+ *
+ * Jobs which can be started right now (for instance a HandlePacketJob) are
+ * spread over one FIFO lane per Scheduler thread, each with its own lock,
+ * and an idle thread steals jobs from the lanes of the others. A job with
+ * an affinity key always goes to the lane selected by its key, and is
+ * never stolen, so jobs with the same key are run in order by one thread.
+ * In a lane, jobs with a higher priority are started first.
+ *
+ * The timed jobs are kept in a binary heap sorted by start time, shared by
+ * all the threads, each job remembering its position in the heap.
+ */
 class SchedulerQueue : public Mutex
 {
 public:
+	/** Position of a job which isn't in the timer heap */
+	static const size_t NOT_QUEUED = (size_t)-1;
+
+	/** Maximum number of worker lanes, and so of Scheduler threads */
+	static const size_t MAX_LANES = 32;
+
 	SchedulerQueue();
 	~SchedulerQueue();
 
-	/** @return the next job to be executed from the queue */
-	Job* PopJob();
+	/** Set the number of Scheduler threads, each one owning a lane.
+	 *
+	 * The number of lanes never decreases, so that jobs which are already
+	 * queued are still reachable. Jobs in a lane without owner can be
+	 * stolen whatever their affinity.
+	 */
+	void SetWorkers(size_t nb);
+
+	/** Get the next job to be executed.
+	 *
+	 * Timed jobs which are due are returned first, as they are already
+	 * late, then immediate jobs.
+	 *
+	 * @param now  the current time
+	 * @return the next job to be executed, or NULL if none is due.
+	 */
+	Job* PopJob(double now);
+
+	/** Wait for the next job to be executed.
+	 *
+	 * The calling thread takes jobs from its own lane, then from the lanes
+	 * of the other threads, and sleeps until the next job is due, or until
+	 * a new job is queued.
+	 *
+	 * @param lane  lane of the calling thread
+	 * @param thread  the calling thread
+	 * @return the job to execute, or NULL if the thread has been stopped.
+	 */
+	Job* WaitJob(size_t lane, Thread* thread);
+
+	/** Wake up all the threads waiting in WaitJob(), for instance to stop them. */
+	void WakeUp();
 
 	/** Put a new job into the queue */
 	void Queue(Job* job);
 
-	/** Remove a job from the queue */
+	/** Remove a job from the queue, and delete it.
+	 *
+	 * Nothing is done if the job isn't queued anymore, even if it has
+	 * already been run and deleted.
+	 */
 	void Cancel(Job* job);
 
 	/** Remove all jobs of a specific type from the queue */
-	void CancelType(std::type_info type);
+	void CancelType(const std::type_info& type);
 
 	/** @return the date of the next scheduled job */
 	double NextJobTime();
@@ -55,9 +109,56 @@ public:
 	/** @return the size of the queue */
 	size_t GetQueueSize();
 
+	/** @return the size of the queue, without locking it, so it may be
+	 * slightly out of date.
+	 */
+	size_t GetApproxQueueSize() const;
+
 private:
-	typedef std::list<Job*> JobList;
-	JobList jobs;
+	typedef std::deque<Job*> JobFifo;
+
+	/** Jobs to start as soon as possible, preferably by one thread */
+	class Lane : public Mutex
+	{
+	public:
+		Lane() : seq(0), count(0), asleep(false) {}
+
+		JobFifo free[Job::PRIORITY_MAX];  /**< Jobs which can be stolen */
+		JobFifo bound[Job::PRIORITY_MAX]; /**< Jobs with an affinity key */
+		uint64_t seq;                     /**< Counter to keep FIFO order between free and bound jobs */
+		volatile size_t count;            /**< Number of jobs in the lane */
+
+		Condition wakeup;                 /**< Signaled to wake up the owner of the lane */
+		bool asleep;                      /**< Owner is waiting on wakeup, protected by the SchedulerQueue lock */
+	};
+
+	Lane lanes[MAX_LANES];
+	volatile size_t nb_lanes;   /**< Number of lanes in use */
+	volatile size_t nb_workers; /**< Number of lanes with an owner thread */
+	volatile size_t next_lane;  /**< Lane of the next immediate job */
+
+	typedef std::vector<Job*> JobHeap;
+	JobHeap timers;             /**< Min-heap of jobs, on their start time */
+	volatile size_t nb_timers;  /**< Size of the heap, readable without lock */
+	volatile double next_timer; /**< Start time of the first timed job */
+
+	uint64_t seq;               /**< Counter used to order jobs with the same start time */
+
+	volatile size_t sleeping;   /**< Number of threads waiting for a job */
+
+	void PushLane(size_t lane, Job* job);
+	Job* TakeLane(size_t lane, bool owner);
+	Job* PopTimer(double now, size_t lane);
+	Job* Steal(size_t lane);
+	bool HasDueJob(double now, size_t lane);
+	void WakeLane(size_t lane, bool bound);
+
+	static bool Before(const Job* a, const Job* b);
+	void HeapSet(size_t i, Job* job);
+	void HeapUp(size_t i);
+	void HeapDown(size_t i);
+	void HeapRemove(size_t i);
+	void UpdateNextTimer();
 };
 
 /* Singleton */
@@ -0,0 +1,215 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <cstdlib>
+#include <cxxabi.h>
+#include <sstream>
+
+#include <util/pf_log.h>
+#include <util/time.h>
+#include "job.h"
+#include "scheduler_queue.h"
+#include "scheduler_stats.h"
+
+SchedulerStats scheduler_stats;
+
+JobTypeStats::JobTypeStats()
+	: runs(0),
+	  repeats(0),
+	  total_wait(0.0),
+	  max_wait(0.0),
+	  total_run(0.0),
+	  max_run(0.0)
+{
+	for(size_t i = 0; i < NB_BUCKETS; ++i)
+		wait_hist[i] = run_hist[i] = 0;
+}
+
+size_t JobTypeStats::Bucket(double duration)
+{
+	size_t i = 0;
+	for(double us = duration * 1000000.0; us >= 1.0 && i < NB_BUCKETS - 1; us /= 2)
+		++i;
+	return i;
+}
+
+void JobTypeStats::Merge(const JobTypeStats& other)
+{
+	runs += other.runs;
+	repeats += other.repeats;
+	total_wait += other.total_wait;
+	total_run += other.total_run;
+	if(other.max_wait > max_wait)
+		max_wait = other.max_wait;
+	if(other.max_run > max_run)
+		max_run = other.max_run;
+	for(size_t i = 0; i < NB_BUCKETS; ++i)
+	{
+		wait_hist[i] += other.wait_hist[i];
+		run_hist[i] += other.run_hist[i];
+	}
+}
+
+std::string JobTypeStats::GetStr() const
+{
+	std::ostringstream out;
+
+	out << name << ": runs=" << runs << " repeats=" << repeats;
+	if(runs)
+		out << " wait(avg=" << total_wait / static_cast<double>(runs) * 1000.0 << "ms max=" << max_wait * 1000.0 << "ms)"
+		    << " run(avg=" << total_run / static_cast<double>(runs) * 1000.0 << "ms max=" << max_run * 1000.0 << "ms)";
+	return out.str();
+}
+
+/** A job which logs the statistics of the scheduler. */
+class DumpSchedulerStatsJob : public Job
+{
+	bool Start()
+	{
+		pf_log[W_INFO] << scheduler_stats.GetStr();
+		return true;
+	}
+
+public:
+	DumpSchedulerStatsJob(double interval)
+		: Job(time::dtime() + interval, REPEAT_PERIODIC, interval)
+	{}
+};
+
+SchedulerStats::SchedulerStats()
+	: queue_depth(0)
+{
+}
+
+std::string SchedulerStats::GetTypeName(const std::type_info& type)
+{
+	int status;
+	char* name = abi::__cxa_demangle(type.name(), NULL, NULL, &status);
+
+	if(!name)
+		return type.name();
+
+	std::string str = name;
+	free(name);
+	return str;
+}
+
+void SchedulerStats::Record(size_t lane, const std::type_info& type, double wait, double run, bool repeat, size_t depth)
+{
+	if(wait < 0)
+		wait = 0;
+
+	Slot& slot = slots[lane % SchedulerQueue::MAX_LANES];
+	BlockLockMutex lock(&slot);
+
+	StatsMap::iterator it = slot.stats.find(&type);
+	if(it == slot.stats.end())
+	{
+		it = slot.stats.insert(StatsMap::value_type(&type, JobTypeStats())).first;
+		it->second.name = GetTypeName(type);
+	}
+
+	JobTypeStats& s = it->second;
+	s.runs++;
+	if(repeat)
+		s.repeats++;
+	s.total_wait += wait;
+	s.total_run += run;
+	if(wait > s.max_wait)
+		s.max_wait = wait;
+	if(run > s.max_run)
+		s.max_run = run;
+	s.wait_hist[JobTypeStats::Bucket(wait)]++;
+	s.run_hist[JobTypeStats::Bucket(run)]++;
+
+	queue_depth = depth;
+	if(depth > slot.queue_high_water)
+		slot.queue_high_water = depth;
+}
+
+std::vector<JobTypeStats> SchedulerStats::GetSnapshot() const
+{
+	StatsMap merged;
+
+	for(size_t l = 0; l < SchedulerQueue::MAX_LANES; ++l)
+	{
+		BlockLockMutex lock(&slots[l]);
+		for(StatsMap::const_iterator it = slots[l].stats.begin(); it != slots[l].stats.end(); ++it)
+		{
+			StatsMap::iterator m = merged.find(it->first);
+			if(m == merged.end())
+				merged.insert(*it);
+			else
+				m->second.Merge(it->second);
+		}
+	}
+
+	std::vector<JobTypeStats> snapshot;
+	for(StatsMap::const_iterator it = merged.begin(); it != merged.end(); ++it)
+		snapshot.push_back(it->second);
+	return snapshot;
+}
+
+size_t SchedulerStats::GetQueueDepth() const
+{
+	return queue_depth;
+}
+
+size_t SchedulerStats::GetQueueHighWater() const
+{
+	size_t high_water = 0;
+
+	for(size_t l = 0; l < SchedulerQueue::MAX_LANES; ++l)
+	{
+		BlockLockMutex lock(&slots[l]);
+		if(slots[l].queue_high_water > high_water)
+			high_water = slots[l].queue_high_water;
+	}
+	return high_water;
+}
+
+void SchedulerStats::Reset()
+{
+	for(size_t l = 0; l < SchedulerQueue::MAX_LANES; ++l)
+	{
+		BlockLockMutex lock(&slots[l]);
+		slots[l].stats.clear();
+		slots[l].queue_high_water = 0;
+	}
+	queue_depth = 0;
+}
+
+std::string SchedulerStats::GetStr() const
+{
+	std::vector<JobTypeStats> snapshot = GetSnapshot();
+	std::ostringstream out;
+
+	out << "Scheduler: queue depth=" << GetQueueDepth() << " high water=" << GetQueueHighWater();
+	for(std::vector<JobTypeStats>::iterator it = snapshot.begin(); it != snapshot.end(); ++it)
+		out << std::endl << "  " << it->GetStr();
+	return out.str();
+}
+
+void SchedulerStats::StartDump(double interval)
+{
+	scheduler_queue.Queue(new DumpSchedulerStatsJob(interval));
+}
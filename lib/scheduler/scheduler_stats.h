@@ -0,0 +1,147 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef SCHEDULER_STATS_H
+#define SCHEDULER_STATS_H
+
+#include <map>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#include <stdint.h>
+
+#include <util/mutex.h>
+#include "scheduler_queue.h"
+
+/** Statistics about the jobs of a concrete type. */
+class JobTypeStats
+{
+public:
+	/** Number of buckets in histograms. The bucket i counts durations
+	 * from 2^(i-1) to 2^i microseconds, the last one counts all the
+	 * longer durations.
+	 */
+	static const size_t NB_BUCKETS = 32;
+
+	JobTypeStats();
+
+	std::string name;        /**< Demangled name of the job class */
+	uint64_t runs;           /**< Number of executions */
+	uint64_t repeats;        /**< Number of executions which asked to be restarted */
+	double total_wait;       /**< Sum of the queue wait times, in seconds */
+	double max_wait;
+	double total_run;        /**< Sum of the run durations, in seconds */
+	double max_run;
+	uint64_t wait_hist[NB_BUCKETS]; /**< Histogram of the queue wait times */
+	uint64_t run_hist[NB_BUCKETS];  /**< Histogram of the run durations */
+
+	/** @return the histogram bucket of a duration in seconds */
+	static size_t Bucket(double duration);
+
+	/** Add the counters of another set of statistics of the same type */
+	void Merge(const JobTypeStats& other);
+
+	/** @return a line with the counters and averages */
+	std::string GetStr() const;
+};
+
+/** Instrumentation of the Scheduler.
+ *
+ * Each Scheduler thread records, for every job it runs, how long the job
+ * waited in the queue after its start time, and how long it ran. This is
+ * used to see which jobs starve the others.
+ *
+ * Every thread has its own counters, which are merged when they are read.
+ */
+class SchedulerStats
+{
+	struct TypeInfoLess
+	{
+		bool operator()(const std::type_info* a, const std::type_info* b) const
+		{
+			return a->before(*b);
+		}
+	};
+
+	typedef std::map<const std::type_info*, JobTypeStats, TypeInfoLess> StatsMap;
+
+	/** Counters of one lane. Its lock is only contended by readers. */
+	class Slot : public Mutex
+	{
+	public:
+		Slot() : queue_high_water(0) {}
+
+		StatsMap stats;
+		size_t queue_high_water;
+	};
+
+	Slot slots[SchedulerQueue::MAX_LANES];
+	volatile size_t queue_depth; /**< Written without lock at each job start */
+
+public:
+
+	SchedulerStats();
+
+	/** @return the demangled name of a type */
+	static std::string GetTypeName(const std::type_info& type);
+
+	/** Record the execution of a job.
+	 *
+	 * @param lane  lane of the Scheduler thread which ran the job
+	 * @param type  dynamic type of the job
+	 * @param wait  time between the start time of the job (or the date it
+	 *              was queued, if later) and its execution, in seconds
+	 * @param run  run duration, in seconds
+	 * @param repeat  true if the job has to be restarted later
+	 * @param depth  size of the queue when the job has been started
+	 */
+	void Record(size_t lane, const std::type_info& type, double wait, double run, bool repeat, size_t depth);
+
+	/** @return a copy of the statistics of all job types */
+	std::vector<JobTypeStats> GetSnapshot() const;
+
+	/** @return the size of the queue at the last job start */
+	size_t GetQueueDepth() const;
+
+	/** @return the largest size of the queue seen at a job start */
+	size_t GetQueueHighWater() const;
+
+	/** Reset all statistics */
+	void Reset();
+
+	/** @return a multi-line report of all statistics */
+	std::string GetStr() const;
+
+	/** Periodically log the report.
+	 *
+	 * The schedulers call it when the session config has a
+	 * scheduler_stats_interval item.
+	 *
+	 * @param interval  seconds between two reports
+	 */
+	void StartDump(double interval);
+};
+
+/* Singleton */
+extern SchedulerStats scheduler_stats;
+
+#endif /* SCHEDULER_STATS_H */
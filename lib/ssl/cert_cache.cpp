@@ -0,0 +1,128 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <time.h>
+#include <openssl/evp.h>
+#include <util/pf_log.h>
+#include <util/tools.h>
+#include "cert_cache.h"
+
+/* Singleton */
+CertCache cert_cache;
+
+CertCache::CertCache()
+	: Mutex(RECURSIVE_MUTEX),
+	hits(0),
+	misses(0)
+{
+}
+
+Key CertCache::Fingerprint(X509* cert)
+{
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int len = 0;
+
+	if(!cert || !X509_digest(cert, EVP_sha1(), md, &len) || len < Key::size)
+		return Key();
+
+	return Key((const char*)md);
+}
+
+bool CertCache::Lookup(const Key& fingerprint, uint32_t crl_version, long* result)
+{
+	BlockLockMutex lock(this);
+
+	EntryMap::iterator it = entries.find(fingerprint);
+	if(it == entries.end())
+	{
+		misses++;
+		return false;
+	}
+
+	/* Computed against an other CRL, or too old. */
+	if(it->second.crl_version != crl_version || it->second.expire < time(NULL))
+	{
+		entries.erase(it);
+		misses++;
+		return false;
+	}
+
+	hits++;
+	*result = it->second.result;
+	return true;
+}
+
+void CertCache::Store(const Key& fingerprint, X509* cert, uint32_t crl_version, long result)
+{
+	if(!fingerprint || !cert)
+		return;
+
+	/* Seconds left before the certificate expires. */
+	int days = 0, secs = 0;
+	if(!ASN1_TIME_diff(&days, &secs, NULL, X509_get0_notAfter(cert)))
+		return;
+	time_t ttl = (time_t)days * 24 * 3600 + secs;
+	if(ttl <= 0)
+		return;
+	if(ttl > ENTRY_TTL)
+		ttl = ENTRY_TTL;
+
+	BlockLockMutex lock(this);
+
+	/* The cache is full, forget everything rather than walking the map
+	 * to find the oldest entry. It'll be filled again by reconnecting peers.
+	 */
+	if(entries.size() >= MAX_ENTRIES && entries.find(fingerprint) == entries.end())
+		entries.clear();
+
+	entry_t& e = entries[fingerprint];
+	e.crl_version = crl_version;
+	e.result = result;
+	e.expire = time(NULL) + ttl;
+}
+
+void CertCache::Invalidate()
+{
+	BlockLockMutex lock(this);
+	pf_log[W_DEBUG] << "Certificate cache invalidated (" << entries.size() << " entries)";
+	entries.clear();
+}
+
+uint64_t CertCache::GetHits() const
+{
+	BlockLockMutex lock(this);
+	return hits;
+}
+
+uint64_t CertCache::GetMisses() const
+{
+	BlockLockMutex lock(this);
+	return misses;
+}
+
+std::string CertCache::GetStr() const
+{
+	BlockLockMutex lock(this);
+	return "entries:" + TypToStr(entries.size())
+	     + " hits:" + TypToStr(hits)
+	     + " misses:" + TypToStr(misses);
+}
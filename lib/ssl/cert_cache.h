@@ -0,0 +1,104 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef CERT_CACHE_H
+#define CERT_CACHE_H
+
+#include <map>
+#include <openssl/x509.h>
+#include <util/key.h>
+#include <util/mutex.h>
+
+/** Cache of peer certificate verification results.
+ *
+ * Peers reconnect often, and verifying again the same chain against the
+ * same CRL is useless work. Results are stored by certificate fingerprint
+ * (SHA-1 of the DER encoding) along with the version of the CRL they were
+ * computed against, so an entry is only reused while this CRL is still the
+ * loaded one.
+ */
+class CertCache : protected Mutex
+{
+public:
+	/** Seconds before a cached result must be computed again, even if the CRL didn't change. */
+	static const time_t ENTRY_TTL = 3600;
+
+	/** Maximum number of cached results. */
+	static const size_t MAX_ENTRIES = 1024;
+
+	CertCache();
+
+	/** Compute the fingerprint of a certificate.
+	 *
+	 * @param cert  the X509 certificate
+	 * @return  the SHA-1 digest of the certificate, as a Key.
+	 */
+	static Key Fingerprint(X509* cert);
+
+	/** Look for a previous verification result.
+	 *
+	 * @param fingerprint  the certificate fingerprint
+	 * @param crl_version  version of the currently loaded CRL
+	 * @param result  set to the X509_V_* code of the verification if found
+	 * @return  true if a valid entry was found.
+	 */
+	bool Lookup(const Key& fingerprint, uint32_t crl_version, long* result);
+
+	/** Store a verification result.
+	 *
+	 * The entry expires after ENTRY_TTL seconds, or when the certificate
+	 * does if it is sooner: a result isn't reused past the notAfter date.
+	 *
+	 * @param fingerprint  the certificate fingerprint, not null
+	 * @param cert  the verified certificate
+	 * @param crl_version  version of the CRL the result was computed against
+	 * @param result  the X509_V_* code of the verification
+	 */
+	void Store(const Key& fingerprint, X509* cert, uint32_t crl_version, long result);
+
+	/** Drop all the entries, called when a new CRL is loaded. */
+	void Invalidate();
+
+	uint64_t GetHits() const;    /**< Number of lookups answered from the cache */
+	uint64_t GetMisses() const;  /**< Number of lookups which needed a real verification */
+
+	/** @return a textual representation of the cache counters. */
+	std::string GetStr() const;
+
+private:
+	struct entry_t
+	{
+		uint32_t crl_version;
+		long result;
+		time_t expire;
+	};
+	typedef std::map<Key, entry_t> EntryMap;
+	EntryMap entries;
+
+	uint64_t hits;
+	uint64_t misses;
+};
+
+/* Singleton */
+extern CertCache cert_cache;
+
+#endif						  /* CERT_CACHE_H */
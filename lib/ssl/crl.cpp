@@ -27,10 +27,11 @@
 #include "crl.h"
 #include "pf_log.h"
 #include "download.h"
+#include "cert_cache.h"
 
 Crl crl;
 
-Crl::Crl() : path(""), crl(NULL), disabled(false)
+Crl::Crl() : path(""), crl(NULL), disabled(false), version(0)
 {
 }
 
@@ -87,6 +88,10 @@ void Crl::Load()
 
 	char* str = X509_NAME_oneline (X509_CRL_get_issuer (crl), 0, 0);
 	pf_log[W_INFO] << "CRL issued by: " << str;
+
+	/* Peers verified against the previous CRL may have been revoked. */
+	version++;
+	cert_cache.Invalidate();
 }
 
 void Crl::Loop()
@@ -34,6 +34,7 @@ class Crl					  /* : public Thread */
 	std::string url;
 	X509_CRL* crl;
 	bool disabled;
+	uint32_t version;                  /**< Incremented each time a CRL is loaded */
 public:
 	Crl();
 	~Crl();
@@ -52,6 +53,10 @@ public:
 	void Disable() { disabled = true; }
 	bool GetDisabled() const { return disabled; }
 
+	/** @return the version of the loaded CRL, used to know if a cached
+	 * certificate verification is still valid. */
+	uint32_t GetVersion() const { return version; }
+
 	void Loop();
 };
 
@@ -32,6 +32,7 @@
 #include "certificate.h"
 #include "connection_ssl.h"
 #include "crl.h"
+#include "cert_cache.h"
 
 SslSsl::SslSsl(std::string cert_file, std::string key_file, std::string cacert_file)
 {
@@ -66,6 +67,7 @@ void SslSsl::SetCertificates(SSL_CTX* ctx)
 	// TODO: specify a callback that checks the peers cert without checking
 	// the certificates purpose
 	SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+	SSL_CTX_set_cert_verify_callback(ctx, VerifyCallback, NULL);
 
 	// Load certificates in the session
 	if((ret = SSL_CTX_use_certificate(ctx, cert.GetSSL()))  <= 0
@@ -103,6 +105,28 @@ SslSsl::~SslSsl()
 {
 }
 
+int SslSsl::VerifyCallback(X509_STORE_CTX* store_ctx, void*)
+{
+	X509* cert = X509_STORE_CTX_get0_cert(store_ctx);
+	Key fingerprint = CertCache::Fingerprint(cert);
+	uint32_t crl_version = crl.GetDisabled() ? 0 : crl.GetVersion();
+	long result;
+
+	if(fingerprint && cert_cache.Lookup(fingerprint, crl_version, &result))
+	{
+		X509_STORE_CTX_set_error(store_ctx, (int)result);
+		return result == X509_V_OK;
+	}
+
+	int ret = X509_verify_cert(store_ctx);
+
+	/* Without a fingerprint, the result can't be found again. */
+	if(fingerprint)
+		cert_cache.Store(fingerprint, cert, crl_version, X509_STORE_CTX_get_error(store_ctx));
+
+	return ret;
+}
+
 void SslSsl::ForceDisconnect(SSL* ssl, int fd)
 {
 	if(ssl)
@@ -41,6 +41,11 @@ private:
 
 	void SetCertificates(SSL_CTX* ctx);
 	void CheckPeerCertificate(SSL* ssl);
+
+	/** Verify the peer's chain, using the cert_cache to skip the
+	 * verification of a certificate already checked against the same CRL.
+	 */
+	static int VerifyCallback(X509_STORE_CTX* store_ctx, void* arg);
 	void ForceDisconnect(SSL* ssl, int fd);
 public:
 	class SslHandshakeFailed : public StrException
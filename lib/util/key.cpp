@@ -26,7 +26,6 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <stdio.h>
 #include <cassert>
 #include <openssl/sha.h>
 #include <arpa/inet.h>
@@ -81,6 +80,31 @@ Key::Key(std::string str)
 	*this = str.c_str();
 }
 
+/** Value of each hexadecimal char, or -1 if the char isn't an hexadecimal digit. */
+static const signed char hex_values[256] =
+{
+#define X -1
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, X, X, X, X, X, X,
+	X,10,11,12,13,14,15, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X,10,11,12,13,14,15, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+#undef X
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
 Key::Key(const Key& k2)
 {
 	size_t i;
@@ -88,38 +112,31 @@ Key::Key(const Key& k2)
 		this->t[i] = k2.t[i];
 }
 
-Key& Key::operator= (const char *strOrig)
+Key& Key::operator= (const char *str)
 {
-	return Key::operator=(std::string(strOrig));
-}
+	if(str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+		str += 2;
 
-Key& Key::operator=(std::string str)
-{
-	if(str.find("0x") != std::string::npos)
-		str = str.substr(2);
+	/* Only the leading hexadecimal digits are read. */
+	size_t len = 0;
+	while(hex_values[(unsigned char)str[len]] >= 0)
+		len++;
 
-	size_t i = 0;
-	while(i < nlen && str.size() > 0)
-	{
-		if(str.size() > 8)
-		{
-			std::string str_number = str.substr(str.size() - 8, 8);
-			std::istringstream iss(str_number);
-			iss >> std::hex >> t[i];
-			str.erase(str.end() - 8, str.end());
-		}
-		else
-		{
-			std::istringstream iss(str);
-			iss >> std::hex >> t[i];
-			str = "";
-		}
-		i++;
-	}
+	for(size_t i = 0; i < nlen; ++i)
+		t[i] = 0;
+
+	/* Digits are read from the least significant one. */
+	for(size_t i = 0; i < len && i < ndigits; ++i)
+		t[i / 8] |= (uint32_t) hex_values[(unsigned char)str[len - 1 - i]] << (HEXA_BASE * (i % 8));
 
 	return *this;
 }
 
+Key& Key::operator=(std::string str)
+{
+	return Key::operator=(str.c_str());
+}
+
 Key& Key::operator=(const Key& k2)
 {
 	size_t i;
@@ -131,99 +148,98 @@ Key& Key::operator=(const Key& k2)
 
 bool Key::operator==(const Key& k2) const
 {
-	size_t i;
-	for (i = 0; i < nlen; i++)
-		if (this->t[i] != k2.t[i])
-			return false;
-	return true;
+	return memcmp(t, k2.t, sizeof(t)) == 0;
 }
 
 bool Key::operator!() const
 {
+	uint32_t bits = 0;
 	for(size_t i = 0; i < nlen; ++i)
-		if(t[i] > 0)
-			return false;
+		bits |= t[i];
 
-	return true;
+	return bits == 0;
 }
 
-bool Key::operator>(const Key& k2) const
+int Key::Compare(const Key& k2) const
 {
-	for (int i = nlen-1; i >= 0; i--)
-	{
-		if (this->t[i] > k2.t[i])
-			return true;
-		else if (this->t[i] < k2.t[i])
-			return false;
-	}
-	return false;
+	for(size_t i = nlen; i-- > 0;)
+		if(t[i] != k2.t[i])
+			return t[i] < k2.t[i] ? -1 : 1;
+	return 0;
 }
 
-bool Key::operator<(const Key& k2) const
+void Key::GetStr(char* buf) const
 {
-	for (int i = nlen-1; i >= 0; i--)
-	{
-		if (this->t[i] < k2.t[i])
-			return true;
-		else if (this->t[i] > k2.t[i])
-			return false;
-	}
-	return false;
+	*buf++ = '0';
+	*buf++ = 'x';
+	for(size_t i = nlen; i-- > 0;)
+		for(int shift = 28; shift >= 0; shift -= HEXA_BASE)
+			*buf++ = hex_digits[(t[i] >> shift) & 0xf];
+	*buf = '\0';
 }
 
 std::string Key::GetStr() const
 {
-	char keystr[HEXA_KEYLENGTH + 3] = {0};
+	char keystr[strsize + 1];
 
-	sprintf (keystr, "0x%08x%08x%08x%08x%08x",
-		    (unsigned int) this->t[4], (unsigned int) this->t[3],
-		    (unsigned int) this->t[2], (unsigned int) this->t[1],
-		    (unsigned int) this->t[0]);
+	GetStr(keystr);
 
-	return std::string(keystr);
+	return std::string(keystr, strsize);
 }
 
 Key::operator bool() const
 {
+	uint32_t bits = 0;
 	for(size_t i = 0; i < nlen; ++i)
-		if(t[i] > 0)
-			return true;
-	return false;
+		bits |= t[i];
+
+	return bits != 0;
 }
 
-void Key::MakeHash (std::string s)
+void Key::MakeHash (const std::string& s)
 {
 	MakeHash(s.c_str(), s.size());
-	pf_log[W_DEBUG] << "Key::MakeHash: HASH(" << s << ") = [" << *this << "]";
 }
 
 void Key::MakeHash (const char *s, size_t str_size)
 {
-	unsigned char *digest = new unsigned char[SHA_DIGEST_LENGTH];
+	unsigned char digest[SHA_DIGEST_LENGTH];
 
 	SHA1((const unsigned char*) s, str_size, digest);
 
-	unsigned char *p = digest;
+	const unsigned char *p = digest;
 	for(size_t i = 0; i < Key::nlen; ++i)
 	{
-		t[i] = ntohl(*(uint32_t*)p);
-		p += sizeof(t[i]);
+		uint32_t nbr;
+		memcpy(&nbr, p, sizeof(nbr));
+		t[i] = ntohl(nbr);
+		p += sizeof(nbr);
 	}
-	delete[] digest;
 }
 
 Key Key::distance(const Key& k2) const
 {
 	Key diff;
 
-	if (*this > k2)
-		diff = *this - k2;
+	if (Compare(k2) > 0)
+		Sub(k2, diff);
 	else
-		diff = k2 - *this;
+		k2.Sub(*this, diff);
 
+	/* Key_Max - diff */
 	if (diff > Key_Half)
-		diff = Key_Max - diff;
+		for (size_t i = 0; i < nlen; i++)
+			diff.t[i] = ~diff.t[i];
+
+	return diff;
+}
+
+Key Key::ClockwiseDistance(const Key& k2) const
+{
+	Key diff;
 
+	/* Modulo 2^KEY_SIZE, so it wraps around zero. */
+	k2.Sub(*this, diff);
 	return diff;
 }
 
@@ -255,26 +271,15 @@ bool Key::between (const Key& left, const Key& right) const
 	}
 }
 
-size_t Key::key_index (Key k) const
+size_t Key::key_index (const Key& k) const
 {
-	size_t max_len, i;
-	std::string mystr, kstr;
-
-	max_len = HEXA_KEYLENGTH;
-	mystr = this->GetStr();
-	kstr = k.GetStr();
-
-	for (i = 0; (mystr[i] == kstr[i]) && (i < max_len); i++)
-		;
+	/* Skip the "0x" prefix. */
+	size_t i = CommonPrefixDigits(k) + 2;
 
-	if (i == max_len)
-		i = max_len - 1;
+	if (i >= HEXA_KEYLENGTH)
+		i = HEXA_KEYLENGTH - 1;
 
-	pf_log[W_DEBUG] << "key_index:" << i;
-	pf_log[W_DEBUG] << "me:" << *this;
-	pf_log[W_DEBUG] << "lookup_key:" << k;
-
-	return (i);
+	return i;
 }
 
 void Key::dump(char* p) const
@@ -311,38 +316,33 @@ Key Key::Init_Half ()
 Key Key::operator+(const Key& op2) const
 {
 	Key result;
-	double tmp, a, b;
-	size_t i;
-	a = b = tmp = 0;
+	uint64_t carry = 0;
 
-	for (i = 0; i < nlen; i++)
+	for (size_t i = 0; i < nlen; i++)
 	{
-		a = this->t[i];
-		b = op2.t[i];
-		tmp += a + b;
-
-		if (tmp > ULONG_MAX)
-		{
-			result.t[i] = (uint32_t) tmp;
-			tmp = 1;
-		}
-		else
-		{
-			result.t[i] = (uint32_t) tmp;
-			tmp = 0;
-		}
+		carry += (uint64_t) this->t[i] + op2.t[i];
+		result.t[i] = (uint32_t) carry;
+		carry >>= 32;
 	}
 
 	return result;
 }
 
+void Key::Sub(const Key& op2, Key& result) const
+{
+	uint64_t borrow = 0;
+
+	for (size_t i = 0; i < nlen; i++)
+	{
+		uint64_t tmp = (uint64_t) this->t[i] - op2.t[i] - borrow;
+		result.t[i] = (uint32_t) tmp;
+		borrow = tmp >> 63;
+	}
+}
+
 Key Key::operator-(const Key & op2) const
 {
 	Key result;
-	size_t i;
-	double tmp, a, b, carry;
-
-	carry = 0;
 
 	if (*this < op2)
 	{
@@ -350,23 +350,6 @@ Key Key::operator-(const Key & op2) const
 		return result;
 	}
 
-	for (i = 0; i < nlen; i++)
-	{
-		a = this->t[i] - carry;
-		b = op2.t[i];
-
-		if (b <= a)
-		{
-			 tmp = a - b;
-			 carry = 0;
-		}
-		else
-		{
-			a = a + (double)UINT_MAX + 1;
-			tmp = a - b;
-			carry = 1;
-		}
-		result.t[i] = (uint32_t) tmp;
-	}
+	Sub(op2, result);
 	return result;
 }
@@ -46,6 +46,10 @@ public:
 	static const size_t size = (KEY_SIZE / 8);
 	/** Size of the key in uint32_t */
 	static const size_t nlen = (KEY_SIZE / (8 * sizeof(uint32_t)));
+	/** Number of hexadecimal digits of the key */
+	static const size_t ndigits = (KEY_SIZE / HEXA_BASE);
+	/** Size of the string representation of the key, without the nul char */
+	static const size_t strsize = (ndigits + 2);
 
 	static const Key Key_Max;
 	static const Key Key_Half;
@@ -112,19 +116,35 @@ public:
 	 * @param k2 other key which is compared to.
 	 * @return true if I'm superior than k2.
 	 */
-	bool operator>(const Key& k2) const;
-	bool operator<(const Key& k2) const;
+	bool operator>(const Key& k2) const { return Compare(k2) > 0; }
+	bool operator<(const Key& k2) const { return Compare(k2) < 0; }
+	bool operator>=(const Key& k2) const { return Compare(k2) >= 0; }
+	bool operator<=(const Key& k2) const { return Compare(k2) <= 0; }
+
+	/** Compare with an other key.
+	 *
+	 * @param k2 other key
+	 * @return -1, 0 or 1 if I'm lower, equal or greater than k2.
+	 */
+	int Compare(const Key& k2) const;
 
 	/** Return the string hexadecimal representation of key. */
 	std::string GetStr() const;
 
+	/** Write the string hexadecimal representation of key.
+	 *
+	 * @param buf  a buffer of at least strsize + 1 chars, which will be
+	 *             nul terminated.
+	 */
+	void GetStr(char* buf) const;
+
 	const uint32_t* GetArray() const { return t; }
 
 	/** Assign sha1 hash of the string
 	 *
 	 * @param s hashed string.
 	 */
-	void MakeHash (std::string s);
+	void MakeHash (const std::string& s);
 
 	/** Asign sha1 hash of the string
 	 *
@@ -140,6 +160,13 @@ public:
 	*/
 	Key distance(const Key& k2) const;
 
+	/** Calculate the clockwise distance from this to another key
+	*
+	* @param k2 the other key
+	* @return how far k2 is when going clockwise around the ring from this
+	*/
+	Key ClockwiseDistance(const Key& k2) const;
+
 	/** Check if the key is between 2 others keys
 	*
 	* check to see if the value of this falls in the range from left clockwise
@@ -163,14 +190,80 @@ public:
 
 	/** Calculate the lenght of the longest prefix match between this and a key
 	*
+	* It is an index in the string returned by GetStr(), so it counts the
+	* "0x" prefix, and it is at most HEXA_KEYLENGTH - 1.
+	*
 	* @param key you wan't compare prefix with this
 	* @return size of the prefix match
 	*/
-	size_t key_index (Key k) const;
+	size_t key_index (const Key& k) const;
+
+	/** Number of leading bits shared with an other key.
+	 *
+	 * @param k  the other key
+	 * @return  a number from 0 to KEY_SIZE.
+	 */
+	size_t CommonPrefixBits(const Key& k) const
+	{
+		for(size_t i = nlen; i-- > 0;)
+		{
+			uint32_t x = t[i] ^ k.t[i];
+			if(x)
+				return (nlen - 1 - i) * 32 + (size_t) __builtin_clz(x);
+		}
+		return KEY_SIZE;
+	}
+
+	/** Number of leading hexadecimal digits shared with an other key.
+	 *
+	 * @param k  the other key
+	 * @return  a number from 0 to ndigits.
+	 */
+	size_t CommonPrefixDigits(const Key& k) const
+	{
+		return CommonPrefixBits(k) / HEXA_BASE;
+	}
+
+	/** Get some consecutive bits of the key.
+	 *
+	 * Bits past the end of the key are read as zeros.
+	 *
+	 * @param pos  position of the first bit, 0 is the most significant one
+	 * @param nbits  number of bits to read, from 1 to 32
+	 * @return  the bits, the last one being the least significant.
+	 */
+	uint32_t GetBits(size_t pos, size_t nbits) const
+	{
+		size_t i = nlen - 1 - pos / 32;
+		uint64_t window = (uint64_t) t[i] << 32;
+		if(i > 0)
+			window |= t[i - 1];
+		return (uint32_t) ((window << (pos % 32)) >> (64 - nbits));
+	}
+
+	/** Get an hexadecimal digit of the key.
+	 *
+	 * @param i  position of the digit, 0 is the most significant one
+	 * @return  the value of the digit, from 0 to 15.
+	 */
+	size_t Digit(size_t i) const
+	{
+		return (t[nlen - 1 - i / 8] >> (28 - HEXA_BASE * (i % 8))) & 0xf;
+	}
 
 	/** Serialyze the key in binary format */
 	void dump(char* buf) const;
 
+	/** Add two keys, modulo 2^KEY_SIZE. */
+	Key operator+(const Key& op2) const;
+
+	/** Subtract a key.
+	 *
+	 * @param k2  a key lower or equal to this one
+	 * @return  the difference, or a null key if k2 is greater.
+	 */
+	Key operator-(const Key& k2) const;
+
 private:
 	uint32_t t[nlen];
 
@@ -178,17 +271,33 @@ private:
 	static Key Init_Max();
 	static Key Init_Half();
 
-	Key operator+(const Key& op2) const;
-	Key operator-(const Key& k2) const;
+	/** Subtract without checking that the result is positive. */
+	void Sub(const Key& op2, Key& result) const;
 };
 
 template<>
 inline Log::flux& Log::flux::operator<< <Key> (Key key)
 {
-	_str += key.GetStr();
+	char buf[Key::strsize + 1];
+	key.GetStr(buf);
+	_str += buf;
 	return *this;
 }
 
 typedef std::set<Key> KeyList;
 
+/** Hash functor to use keys in hashed containers.
+ *
+ * Keys are mostly SHA-1 digests, so their lower bits are already well
+ * distributed.
+ */
+struct KeyHash
+{
+	size_t operator()(const Key& key) const
+	{
+		const uint32_t* t = key.GetArray();
+		return (size_t) (t[0] ^ t[1] ^ t[2] ^ t[3] ^ t[4]);
+	}
+};
+
 #endif /* KEY_H */
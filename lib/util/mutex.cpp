@@ -27,6 +27,7 @@
 #include <errno.h>
 #include <assert.h>
 #include <cstring>
+#include <math.h>
 #include "mutex.h"
 
 void Mutex::Init(MutexType type)
@@ -112,3 +113,43 @@ void Mutex::Unlock() const
 	if(res)
 		std::cerr << "Failed to unlock " << this << std::endl;
 }
+
+Condition::Condition()
+{
+	if(pthread_cond_init(&_cond, NULL) != 0)
+	{
+		std::cerr << "pthread_cond_init: " << strerror(errno) << std::endl;
+		throw ConditionError();
+	}
+}
+
+Condition::~Condition()
+{
+	pthread_cond_destroy(&_cond);
+}
+
+void Condition::Wait(const Mutex& mutex)
+{
+	pthread_cond_wait(&_cond, mutex._mutex);
+}
+
+bool Condition::TimedWait(const Mutex& mutex, double abs_time)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t) abs_time;
+	ts.tv_nsec = (long) ((abs_time - floor(abs_time)) * 1000000000.0);
+	if(ts.tv_nsec >= 1000000000)
+		ts.tv_nsec = 999999999;
+
+	return pthread_cond_timedwait(&_cond, mutex._mutex, &ts) != ETIMEDOUT;
+}
+
+void Condition::Signal()
+{
+	pthread_cond_signal(&_cond);
+}
+
+void Condition::Broadcast()
+{
+	pthread_cond_broadcast(&_cond);
+}
@@ -76,6 +76,45 @@ public:
 
 	/** Unlock the Mutex */
 	void Unlock() const;
+
+	friend class Condition;
+};
+
+/** Condition variable, used with a Mutex.
+ *
+ * The Mutex has to be locked exactly once by the waiting thread, even
+ * if this is a RECURSIVE_MUTEX.
+ */
+class Condition
+{
+	pthread_cond_t _cond;
+
+	Condition(const Condition&);
+	Condition& operator=(const Condition&);
+
+public:
+
+	class ConditionError : public std::exception {};
+
+	Condition();
+	~Condition();
+
+	/** Unlock the mutex and wait for a signal. */
+	void Wait(const Mutex& mutex);
+
+	/** Unlock the mutex and wait for a signal, until a date.
+	 *
+	 * @param mutex  the locked mutex
+	 * @param abs_time  date in time::dtime() format
+	 * @return  false if the date was reached without being signaled.
+	 */
+	bool TimedWait(const Mutex& mutex, double abs_time);
+
+	/** Wake up one waiting thread. */
+	void Signal();
+
+	/** Wake up all the waiting threads. */
+	void Broadcast();
 };
 
 /** Lock a Mutex locally.
@@ -74,6 +74,7 @@ void Thread::Stop()
 	if(!IsRunning())
 		return;
 	running = false;
+	Interrupt();
 	pthread_join(thread_id, NULL);
 	OnStop();
 }
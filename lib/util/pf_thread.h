@@ -45,6 +45,8 @@ protected:
 	virtual void OnStop() {};
 	/* Use it to catch exceptions from the main loop */
 	virtual void ThrowHandler();
+	/* Called by Stop() to wake up the thread if it is blocked in Loop() */
+	virtual void Interrupt() {};
 public:
 	/* Constructors */
 	Thread();
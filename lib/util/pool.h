@@ -0,0 +1,113 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+#include <new>
+#include <util/mutex.h>
+
+/** Recycle the memory of the objects of a class.
+ *
+ * Inherit from Pooled<T> to give T an operator new and an operator delete
+ * which keep up to MAX_FREE released objects in a free list, instead of
+ * giving them back to the heap. This is useful for small objects which
+ * are created and destroyed at a high rate, like the jobs created for
+ * each received packet.
+ *
+ * The free list is shared by all the threads, as objects are usually
+ * created by one thread and destroyed by another.
+ *
+ * @code
+ * class MyJob : public Job, public Pooled<MyJob>
+ * @endcode
+ */
+template<typename T, size_t MAX_FREE = 256>
+class Pooled
+{
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	static Mutex mutex;
+	static FreeBlock* free_list;
+	static size_t nb_free;
+
+public:
+
+	static void* operator new(size_t size)
+	{
+		/* Derived classes may be larger. */
+		if(size == sizeof(T))
+		{
+			BlockLockMutex lock(&mutex);
+			if(free_list)
+			{
+				FreeBlock* block = free_list;
+				free_list = block->next;
+				nb_free--;
+				return block;
+			}
+		}
+		return ::operator new(size);
+	}
+
+	static void operator delete(void* p, size_t size)
+	{
+		if(!p)
+			return;
+
+		if(size == sizeof(T))
+		{
+			BlockLockMutex lock(&mutex);
+			if(nb_free < MAX_FREE)
+			{
+				FreeBlock* block = static_cast<FreeBlock*>(p);
+				block->next = free_list;
+				free_list = block;
+				nb_free++;
+				return;
+			}
+		}
+		::operator delete(p);
+	}
+
+	/** @return the number of objects in the free list */
+	static size_t GetFreeCount()
+	{
+		BlockLockMutex lock(&mutex);
+		return nb_free;
+	}
+};
+
+template<typename T, size_t MAX_FREE>
+Mutex Pooled<T, MAX_FREE>::mutex;
+
+template<typename T, size_t MAX_FREE>
+typename Pooled<T, MAX_FREE>::FreeBlock* Pooled<T, MAX_FREE>::free_list = NULL;
+
+template<typename T, size_t MAX_FREE>
+size_t Pooled<T, MAX_FREE>::nb_free = 0;
+
+#endif /* POOL_H */
@@ -0,0 +1,112 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#include <pthread.h>
+#include "rcu.h"
+
+const void* volatile RcuHazards::slots[RcuHazards::MAX_SLOTS];
+volatile int RcuHazards::claimed[RcuHazards::MAX_SLOTS];
+volatile size_t RcuHazards::nb_slots = 0;
+
+/** Slot of the current thread, MAX_SLOTS + 1 if it has not one yet. */
+static __thread size_t thread_slot = RcuHazards::MAX_SLOTS + 1;
+
+/** Its value is the slot of the thread plus one, given back when the
+ * thread exits. */
+static pthread_key_t slot_key;
+static pthread_once_t slot_key_once = PTHREAD_ONCE_INIT;
+
+static void CreateSlotKey()
+{
+	pthread_key_create(&slot_key, RcuHazards::ThreadExit);
+}
+
+void RcuHazards::ThreadExit(void* value)
+{
+	size_t slot = reinterpret_cast<size_t>(value) - 1;
+
+	slots[slot] = NULL;
+	__sync_synchronize();
+	claimed[slot] = 0;
+}
+
+size_t RcuHazards::ClaimSlot()
+{
+	for(size_t i = 0; i < MAX_SLOTS; ++i)
+	{
+		if(claimed[i] || !__sync_bool_compare_and_swap(&claimed[i], 0, 1))
+			continue;
+
+		/* IsProtected() only looks at the slots below nb_slots. */
+		size_t n;
+		while((n = nb_slots) <= i && !__sync_bool_compare_and_swap(&nb_slots, n, i + 1))
+			;
+
+		pthread_once(&slot_key_once, CreateSlotKey);
+		pthread_setspecific(slot_key, reinterpret_cast<void*>(i + 1));
+		return i;
+	}
+	return MAX_SLOTS + 1;
+}
+
+const void* RcuHazards::Protect(const void* const volatile* ptr, size_t* slot)
+{
+	/* Without a free slot, it is tried again at the next read. */
+	if(thread_slot > MAX_SLOTS)
+		thread_slot = ClaimSlot();
+
+	/* The slot is already used by an enclosing reader of this thread. */
+	if(thread_slot >= MAX_SLOTS || slots[thread_slot])
+	{
+		*slot = MAX_SLOTS;
+		return NULL;
+	}
+
+	*slot = thread_slot;
+
+	/* Publish the pointer we are about to read, and check that it wasn't
+	 * retired in the meantime. */
+	const void* p;
+	do
+	{
+		p = *ptr;
+		slots[thread_slot] = p;
+		__sync_synchronize();
+	} while(p != *ptr);
+
+	return p;
+}
+
+void RcuHazards::Release(size_t slot)
+{
+	__sync_synchronize();
+	slots[slot] = NULL;
+}
+
+bool RcuHazards::IsProtected(const void* p)
+{
+	size_t n = nb_slots;
+	for(size_t i = 0; i < n; ++i)
+		if(slots[i] == p)
+			return true;
+	return false;
+}
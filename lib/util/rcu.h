@@ -0,0 +1,165 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+#ifndef RCU_H
+#define RCU_H
+
+#include <cstddef>
+#include <vector>
+#include <util/mutex.h>
+
+/** Hazard pointer slots shared by all the RcuPointer objects.
+ *
+ * Each thread which reads through a RcuPointer gets a slot the first time,
+ * and writes in it the object it is reading. An object isn't deleted while
+ * a slot refers to it. The slot is given back when the thread exits.
+ */
+class RcuHazards
+{
+public:
+	/** Maximum number of running threads with a slot. Others threads
+	 * read with a lock. */
+	static const size_t MAX_SLOTS = 64;
+
+	/** Protect the object pointed by ptr.
+	 *
+	 * @param ptr  the shared pointer
+	 * @param slot  set to the slot index used
+	 * @return  the protected object, or NULL if this thread has no free
+	 *          slot.
+	 */
+	static const void* Protect(const void* const volatile* ptr, size_t* slot);
+
+	/** Release a slot taken by Protect(). */
+	static void Release(size_t slot);
+
+	/** @return true if a slot refers to p */
+	static bool IsProtected(const void* p);
+
+	/** Give back the slot of an exiting thread. */
+	static void ThreadExit(void* slot);
+
+private:
+	static const void* volatile slots[MAX_SLOTS];
+	static volatile int claimed[MAX_SLOTS];   /**< The slot belongs to a thread */
+	static volatile size_t nb_slots;          /**< Slots which have been used */
+
+	/** @return a free slot, or more than MAX_SLOTS if there is none */
+	static size_t ClaimSlot();
+};
+
+/** Pointer to an immutable object, replaced as a whole by writers.
+ *
+ * Readers never wait for writers: they use a Reader to get the current
+ * version, which stays valid until the Reader is destroyed even if a
+ * writer publishes a new one meanwhile. Writers build a new version and
+ * Publish() it, the previous one is deleted when no reader uses it anymore.
+ *
+ * @code
+ * RcuPointer<State>::Reader state(&rcu_state);
+ * state->Lookup(...);
+ * @endcode
+ */
+template<typename T>
+class RcuPointer : protected Mutex
+{
+	const T* volatile current;
+	std::vector<const T*> retired;
+
+	/** Delete the retired versions which aren't read anymore. */
+	void Reclaim()
+	{
+		for(size_t i = 0; i < retired.size();)
+			if(RcuHazards::IsProtected(retired[i]))
+				++i;
+			else
+			{
+				delete retired[i];
+				retired[i] = retired.back();
+				retired.pop_back();
+			}
+	}
+
+public:
+
+	/** @param init  the first version, owned by the RcuPointer */
+	RcuPointer(const T* init)
+		: current(init)
+	{}
+
+	~RcuPointer()
+	{
+		delete current;
+		for(size_t i = 0; i < retired.size(); ++i)
+			delete retired[i];
+	}
+
+	/** Replace the current version.
+	 *
+	 * @param next  the new version, owned by the RcuPointer
+	 */
+	void Publish(const T* next)
+	{
+		BlockLockMutex lock(this);
+		const T* old = current;
+		current = next;
+		__sync_synchronize();
+		retired.push_back(old);
+		Reclaim();
+	}
+
+	/** Read access to the current version. */
+	class Reader
+	{
+		const RcuPointer* rcu;
+		const T* object;
+		size_t slot;
+
+	public:
+		Reader(const RcuPointer* _rcu)
+			: rcu(_rcu)
+		{
+			object = static_cast<const T*>(RcuHazards::Protect(
+			                 reinterpret_cast<const void* const volatile*>(&rcu->current), &slot));
+
+			/* No slot available, prevent writers to delete anything. */
+			if(!object)
+			{
+				rcu->Lock();
+				object = rcu->current;
+			}
+		}
+
+		~Reader()
+		{
+			if(slot < RcuHazards::MAX_SLOTS)
+				RcuHazards::Release(slot);
+			else
+				rcu->Unlock();
+		}
+
+		const T* operator->() const { return object; }
+		const T& operator*() const { return *object; }
+	};
+};
+
+#endif /* RCU_H */
@@ -29,6 +29,7 @@
 #include <net/hosts_list.h>
 #include <scheduler/scheduler.h>
 #include <util/pf_log.h>
+#include <util/session_config.h>
 #include <util/tools.h>
 #include <chimera/chimera.h>
 #include <chimera/messages.h>
@@ -37,10 +38,14 @@ int main(int argc, char** argv)
 {
 	if(argc < 2)
 	{
-		std::cout << "Usage: " << argv[0] << " listen_port [boostrap_host:port]" << std::endl;
+		std::cout << "Usage: " << argv[0] << " listen_port [boostrap_host:port|\"\" [config_file]]" << std::endl;
 		return EXIT_FAILURE;
 	}
 
+	/* network_secret=... enables the encryption of datagrams. */
+	if(argc > 3)
+		session_cfg.Load(argv[3]);
+
 	Key me(StrToTyp<uint32_t>(argv[1]));
 
 	Chimera* chimera = new Chimera(NULL, StrToTyp<uint16_t>(argv[1]), me);
@@ -48,7 +53,8 @@ int main(int argc, char** argv)
 	pf_log.SetLoggedFlags("ALL", false);
 	Scheduler::StartSchedulers(5);
 
-	if(argc > 2)
+	/* An empty bootstrap starts a new network. */
+	if(argc > 2 && *argv[2])
 	{
 		Host host = hosts_list.DecodeHost(argv[2]);
 		pf_log[W_INFO] << "Connecting to " << host;
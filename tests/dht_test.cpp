@@ -33,23 +33,33 @@
 #include <net/hosts_list.h>
 #include <scheduler/scheduler.h>
 #include <util/pf_log.h>
+#include <util/session_config.h>
 
 int main(int argc, char** argv)
 {
 	if(argc < 2)
 	{
-		std::cout << "Usage: " << argv[0] << " listen_port [boostrap_host:port]" << std::endl;
+		std::cout << "Usage: " << argv[0] << " listen_port [boostrap_host:port|\"\" [snapshot_file [config_file]]]" << std::endl;
 		return EXIT_FAILURE;
 	}
 
 	srand((unsigned)time(NULL));
 
+	/* network_secret=... enables the encryption of datagrams. */
+	if(argc > 4)
+		session_cfg.Load(argv[4]);
+
 	DHT* dht = new DHT(NULL, StrToTyp<uint16_t>(argv[1]));
 
 	pf_log.SetLoggedFlags("DESYNCH WARNING ERR INFO DHT", false);
 	Scheduler::StartSchedulers(5);
 
-	if(argc > 2)
+	/* Warm restart from the hosts known by the previous run. */
+	if(argc > 3 && *argv[3])
+		dht->GetChimera()->LoadSnapshot(argv[3]);
+
+	/* An empty bootstrap starts a new network. */
+	if(argc > 2 && *argv[2])
 	{
 		Host host = hosts_list.DecodeHost(argv[2]);
 		pf_log[W_INFO] << "Connecting to " << host;
@@ -73,11 +83,11 @@ int main(int argc, char** argv)
 				break;
 			case 'l': /* Leafset */
 			case 'L':
-				pf_log[W_DHT] << dht->GetChimera()->GetRouting()->GetLeafset()->GetStr();
+				pf_log[W_DHT] << dht->GetChimera()->GetRouting()->GetLeafset().GetStr();
 				break;
 			case 'r': /* Routing table */
 			case 'R':
-				pf_log[W_DHT] << dht->GetChimera()->GetRouting()->GetRoutingTable()->GetStr();
+				pf_log[W_DHT] << dht->GetChimera()->GetRouting()->GetRoutingTable().GetStr();
 				break;
 			case 'p': /* Publish */
 			case 'P':
@@ -99,13 +109,23 @@ int main(int argc, char** argv)
 					if(dht->GetStorage()->hasKey(k))
 						pf_log[W_DHT] << dht->GetStorage()->getInfo(k)->GetStr();
 				break;
+			case 'i': /* GET with an iterative lookup */
+			case 'I':
+				k = s;
+				pf_log[W_DHT] << "Request data with key " << k << " (iterative lookup)";
+				if(!dht->RequestData(k, DHT::ITERATIVE))
+					if(dht->GetStorage()->hasKey(k))
+						pf_log[W_DHT] << dht->GetStorage()->getInfo(k)->GetStr();
+				break;
 			case 'q': /* Quit */
 			case 'Q':
+				dht->GetChimera()->SaveSnapshot();
 				return EXIT_SUCCESS;
 			default:
 				pf_log[W_ERR] << "Command not recognized.";
 		}
 	}
 
+	dht->GetChimera()->SaveSnapshot();
 	return EXIT_SUCCESS;
 }
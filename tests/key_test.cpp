@@ -0,0 +1,417 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+/* Checks the Key arithmetic, bit access and hex codec against the
+ * previous implementation, which used doubles and went through
+ * GetStr(), then times both of them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <vector>
+
+#include <util/key.h>
+#include <util/time.h>
+
+namespace old_key
+{
+	const size_t nlen = Key::nlen;
+
+	void Copy(const Key& k, uint32_t* t)
+	{
+		for(size_t i = 0; i < nlen; ++i)
+			t[i] = k.GetArray()[i];
+	}
+
+	bool Less(const uint32_t* a, const uint32_t* b)
+	{
+		for(int i = (int) nlen - 1; i >= 0; i--)
+		{
+			if(a[i] < b[i])
+				return true;
+			else if(a[i] > b[i])
+				return false;
+		}
+		return false;
+	}
+
+	/* The carry test compares with ULONG_MAX, so it never carries on
+	 * LP64 platforms. The cast of a sum above UINT_MAX keeps its low
+	 * bits on x86-64, it is done through uint64_t here to stay defined.
+	 */
+	Key Add(const Key& k1, const Key& k2)
+	{
+		uint32_t result[nlen];
+		double tmp = 0, a, b;
+
+		for(size_t i = 0; i < nlen; i++)
+		{
+			a = k1.GetArray()[i];
+			b = k2.GetArray()[i];
+			tmp += a + b;
+
+			if(tmp > (double) ULONG_MAX)
+			{
+				result[i] = (uint32_t) (uint64_t) tmp;
+				tmp = 1;
+			}
+			else
+			{
+				result[i] = (uint32_t) (uint64_t) tmp;
+				tmp = 0;
+			}
+		}
+		return Key(result);
+	}
+
+	void Sub(const uint32_t* k1, const uint32_t* k2, uint32_t* result)
+	{
+		double tmp, a, b, carry = 0;
+
+		for(size_t i = 0; i < nlen; i++)
+		{
+			a = k1[i] - carry;
+			b = k2[i];
+
+			if(b <= a)
+			{
+				tmp = a - b;
+				carry = 0;
+			}
+			else
+			{
+				a = a + (double)UINT_MAX + 1;
+				tmp = a - b;
+				carry = 1;
+			}
+			result[i] = (uint32_t) tmp;
+		}
+	}
+
+	Key Sub(const Key& k1, const Key& k2)
+	{
+		uint32_t a[nlen], b[nlen], result[nlen];
+		Copy(k1, a);
+		Copy(k2, b);
+		Sub(a, b, result);
+		return Key(result);
+	}
+
+	Key Distance(const Key& k1, const Key& k2)
+	{
+		uint32_t a[nlen], b[nlen], diff[nlen], max[nlen], half[nlen];
+		Copy(k1, a);
+		Copy(k2, b);
+		for(size_t i = 0; i < nlen; i++)
+			max[i] = half[i] = UINT_MAX;
+		half[nlen - 1] /= 2;
+
+		if(Less(b, a))
+			Sub(a, b, diff);
+		else
+			Sub(b, a, diff);
+
+		if(Less(half, diff))
+		{
+			uint32_t tmp[nlen];
+			Sub(max, diff, tmp);
+			return Key(tmp);
+		}
+		return Key(diff);
+	}
+
+	std::string GetStr(const Key& k)
+	{
+		const uint32_t* t = k.GetArray();
+		char keystr[HEXA_KEYLENGTH + 3] = {0};
+
+		sprintf(keystr, "0x%08x%08x%08x%08x%08x",
+		        (unsigned int) t[4], (unsigned int) t[3],
+		        (unsigned int) t[2], (unsigned int) t[1],
+		        (unsigned int) t[0]);
+		return std::string(keystr);
+	}
+
+	Key Parse(std::string str)
+	{
+		uint32_t t[nlen] = {0};
+
+		if(str.find("0x") != std::string::npos)
+			str = str.substr(2);
+
+		size_t i = 0;
+		while(i < nlen && str.size() > 0)
+		{
+			if(str.size() > 8)
+			{
+				std::istringstream iss(str.substr(str.size() - 8, 8));
+				iss >> std::hex >> t[i];
+				str.erase(str.end() - 8, str.end());
+			}
+			else
+			{
+				std::istringstream iss(str);
+				iss >> std::hex >> t[i];
+				str = "";
+			}
+			i++;
+		}
+		return Key(t);
+	}
+
+	size_t KeyIndex(const Key& k1, const Key& k2)
+	{
+		size_t max_len = HEXA_KEYLENGTH, i;
+		std::string mystr = GetStr(k1), kstr = GetStr(k2);
+
+		for(i = 0; (mystr[i] == kstr[i]) && (i < max_len); i++)
+			;
+		if(i == max_len)
+			i = max_len - 1;
+		return i;
+	}
+
+	/* The routing table read a digit from the string. */
+	size_t Digit(const Key& k, size_t i)
+	{
+		static const char hexalpha[] = "0123456789abcdef";
+		char c = GetStr(k)[i + 2];
+		for(size_t j = 0; hexalpha[j]; j++)
+			if(hexalpha[j] == c)
+				return j;
+		return 0;
+	}
+
+	/* One char per bit, most significant first. */
+	std::string GetBinary(const Key& k)
+	{
+		std::string hex = GetStr(k).substr(2), bin;
+		for(size_t i = 0; i < hex.size(); i++)
+		{
+			size_t d = Digit(k, i);
+			for(int b = 3; b >= 0; b--)
+				bin += (d >> b) & 1 ? '1' : '0';
+		}
+		return bin;
+	}
+}
+
+static size_t failures = 0;
+
+static void Check(bool ok, const char* what, const Key& a, const Key& b)
+{
+	if(ok)
+		return;
+	if(++failures <= 20)
+		std::cerr << "FAILED: " << what << " " << old_key::GetStr(a) << " " << old_key::GetStr(b) << std::endl;
+}
+
+/* Limbs near the carry boundaries are much more likely than in random keys. */
+static uint32_t RandomLimb()
+{
+	switch(rand() % 8)
+	{
+		case 0: return 0;
+		case 1: return 1;
+		case 2: return 0x7fffffff;
+		case 3: return 0x80000000;
+		case 4: return 0xffffffff;
+		case 5: return 0xfffffffe;
+		default: return (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+	}
+}
+
+static Key RandomKey()
+{
+	if(rand() % 2)
+		return Key::GetRandomKey();
+
+	uint32_t t[Key::nlen];
+	for(size_t i = 0; i < Key::nlen; i++)
+		t[i] = RandomLimb();
+	return Key(t);
+}
+
+/* Flip one bit, so both keys share a prefix of pos bits. */
+static Key FlipBit(const Key& k, size_t pos)
+{
+	uint32_t t[Key::nlen];
+	old_key::Copy(k, t);
+	t[Key::nlen - 1 - pos / 32] ^= 0x80000000u >> (pos % 32);
+	return Key(t);
+}
+
+static void CheckArithmetic(const Key& a, const Key& b)
+{
+	bool limb_carry = false;
+	for(size_t i = 0; i < Key::nlen; i++)
+		if((uint64_t) a.GetArray()[i] + b.GetArray()[i] > UINT_MAX)
+			limb_carry = true;
+
+	Key sum = a + b;
+	if(!limb_carry)
+		Check(sum == old_key::Add(a, b), "add differs from the old one", a, b);
+	Check(sum == b + a, "add isn't commutative", a, b);
+	Check(a.ClockwiseDistance(sum) == b, "add and clockwise distance disagree", a, b);
+
+	const Key& big = a < b ? b : a;
+	const Key& small = a < b ? a : b;
+	Check(big - small == old_key::Sub(big, small), "sub differs from the old one", big, small);
+	Check((big - small) + small == big, "sub isn't the inverse of add", big, small);
+
+	Key d = a.distance(b);
+	Check(d == old_key::Distance(a, b), "distance differs from the old one", a, b);
+	Check(d == b.distance(a), "distance isn't symmetric", a, b);
+	Check(d <= Key::Key_Half, "distance is greater than half the ring", a, b);
+}
+
+static void CheckBits(const Key& a, const Key& b)
+{
+	std::string abin = old_key::GetBinary(a), bbin = old_key::GetBinary(b);
+
+	size_t prefix = 0;
+	while(prefix < KEY_SIZE && abin[prefix] == bbin[prefix])
+		prefix++;
+	Check(a.CommonPrefixBits(b) == prefix, "CommonPrefixBits", a, b);
+	Check(a.CommonPrefixDigits(b) == prefix / HEXA_BASE, "CommonPrefixDigits", a, b);
+	Check(a.key_index(b) == old_key::KeyIndex(a, b), "key_index differs from the old one", a, b);
+
+	size_t row = a.CommonPrefixDigits(b);
+	if(row < Key::ndigits)
+		Check(b.Digit(row) == old_key::Digit(b, row), "Digit differs from the old one", a, b);
+
+	size_t pos = (size_t) rand() % KEY_SIZE;
+	size_t nbits = 1 + (size_t) rand() % 32;
+	uint32_t bits = 0;
+	for(size_t i = 0; i < nbits; i++)
+		bits = (bits << 1) | (pos + i < KEY_SIZE && abin[pos + i] == '1');
+	Check(a.GetBits(pos, nbits) == bits, "GetBits", a, b);
+}
+
+static void CheckHex(const Key& a)
+{
+	std::string str = old_key::GetStr(a);
+
+	Check(a.GetStr() == str, "GetStr differs from the old one", a, a);
+	Check(Key(str) == a, "hex round-trip", a, a);
+	Check(Key(str.substr(2)) == a, "hex round-trip without 0x", a, a);
+
+	/* Short strings are the low digits of the key. */
+	std::string tail = str.substr(str.size() - 1 - (size_t) rand() % Key::ndigits);
+	Check(Key(tail) == old_key::Parse(tail), "short hex string differs from the old parser", a, a);
+}
+
+/* Keys which hit the edges of the limbs and of the ring. */
+static void CheckEdges()
+{
+	Key edges[] = { Key(0u), Key(1u), Key(UINT_MAX), Key::Key_Half, Key::Key_Max,
+	                Key::Key_Half + Key(1u), FlipBit(Key(0u), 0), FlipBit(Key(0u), 31),
+	                FlipBit(Key(0u), 32), FlipBit(Key(0u), KEY_SIZE - 1) };
+	size_t n = sizeof edges / sizeof *edges;
+
+	for(size_t i = 0; i < n; i++)
+	{
+		CheckHex(edges[i]);
+		for(size_t j = 0; j < n; j++)
+		{
+			CheckArithmetic(edges[i], edges[j]);
+			CheckBits(edges[i], edges[j]);
+		}
+	}
+
+	Check(Key::Key_Max + Key(1u) == Key(0u), "add doesn't wrap around", Key::Key_Max, Key(1u));
+	Check(Key(UINT_MAX) + Key(1u) == FlipBit(Key(0u), KEY_SIZE - 33), "add doesn't carry", Key(UINT_MAX), Key(1u));
+}
+
+template<typename Op>
+static void Bench(const char* name, Op op, const std::vector<Key>& keys, size_t rounds)
+{
+	size_t sink = 0;
+	double start = time::dtime();
+	for(size_t r = 0; r < rounds; r++)
+		for(size_t i = 0; i + 1 < keys.size(); i++)
+			sink += op(keys[i], keys[i + 1]);
+	double elapsed = time::dtime() - start;
+
+	printf("%-24s %8.1f ns/op  (%zu)\n", name,
+	       elapsed * 1e9 / (double) (rounds * (keys.size() - 1)), sink % 10);
+}
+
+static size_t NewAdd(const Key& a, const Key& b) { return (a + b).GetArray()[0]; }
+static size_t OldAdd(const Key& a, const Key& b) { return old_key::Add(a, b).GetArray()[0]; }
+static size_t NewSub(const Key& a, const Key& b) { return (a < b ? b - a : a - b).GetArray()[0]; }
+static size_t OldSub(const Key& a, const Key& b) { return (a < b ? old_key::Sub(b, a) : old_key::Sub(a, b)).GetArray()[0]; }
+static size_t NewDistance(const Key& a, const Key& b) { return a.distance(b).GetArray()[0]; }
+static size_t OldDistance(const Key& a, const Key& b) { return old_key::Distance(a, b).GetArray()[0]; }
+static size_t NewPrefix(const Key& a, const Key& b) { return a.CommonPrefixDigits(b) + b.Digit(a.CommonPrefixDigits(b) % Key::ndigits); }
+static size_t OldPrefix(const Key& a, const Key& b) { return old_key::KeyIndex(a, b) + old_key::Digit(b, (old_key::KeyIndex(a, b) - 2) % Key::ndigits); }
+static size_t NewHex(const Key& a, const Key&) { return Key(a.GetStr()).GetArray()[0]; }
+static size_t OldHex(const Key& a, const Key&) { return old_key::Parse(old_key::GetStr(a)).GetArray()[0]; }
+
+int main(int argc, char** argv)
+{
+	size_t iterations = argc > 1 ? (size_t) atol(argv[1]) : 100000;
+	size_t rounds = argc > 2 ? (size_t) atol(argv[2]) : 100;
+
+	srand(42);
+
+	CheckEdges();
+	for(size_t i = 0; i < iterations; i++)
+	{
+		Key a = RandomKey(), b = RandomKey();
+		CheckArithmetic(a, b);
+		CheckBits(a, b);
+		CheckBits(a, FlipBit(a, (size_t) rand() % KEY_SIZE));
+		CheckHex(a);
+	}
+
+	if(failures)
+	{
+		printf("%zu failures\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("%zu random pairs checked\n", iterations);
+
+	if(!rounds)
+		return EXIT_SUCCESS;
+
+	std::vector<Key> keys;
+	for(size_t i = 0; i < 1000; i++)
+		keys.push_back(Key::GetRandomKey());
+
+	Bench("add", NewAdd, keys, rounds);
+	Bench("add (old)", OldAdd, keys, rounds);
+	Bench("sub", NewSub, keys, rounds);
+	Bench("sub (old)", OldSub, keys, rounds);
+	Bench("distance", NewDistance, keys, rounds);
+	Bench("distance (old)", OldDistance, keys, rounds);
+	Bench("prefix and digit", NewPrefix, keys, rounds / 10 + 1);
+	Bench("prefix and digit (old)", OldPrefix, keys, rounds / 10 + 1);
+	Bench("hex round-trip", NewHex, keys, rounds / 10 + 1);
+	Bench("hex round-trip (old)", OldHex, keys, rounds / 10 + 1);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright(C) 2008 Laurent Defert, Romain Bignon
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * This product includes cryptographic software written by Eric Young
+ * (eay@cryptsoft.com).  This product includes software written by Tim
+ * Hudson (tjh@cryptsoft.com).
+ *
+ */
+
+/* Checks lookups in routing tables with 2 and 6 bits digits, and with
+ * the built one, against a search of all the hosts, and that copies of a
+ * table don't see its changes. Then routes keys over a network of tables.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <vector>
+
+#include <chimera/routing_table.h>
+#include <net/hosts_list.h>
+#include <util/key.h>
+
+static size_t failures = 0;
+
+static void Check(bool ok, size_t digit_bits, const char* what, const Key& key)
+{
+	if(ok)
+		return;
+	if(++failures <= 20)
+		std::cerr << "FAILED: b=" << digit_bits << " " << what << " " << key.GetStr() << std::endl;
+}
+
+/* A lookup finds a perfect match exactly when a host shares more
+ * digits with the key than the local host.
+ */
+template<size_t DIGIT_BITS>
+static void CheckLookups(const std::vector<Host>& hosts, size_t lookups)
+{
+	typedef BasicRoutingTable<DIGIT_BITS, ROUTING_CELL_ENTRIES> Table;
+	const Key& me = hosts[0].GetKey();
+	Table table(hosts[0]);
+
+	for(size_t i = 1; i < hosts.size(); ++i)
+		table.add(hosts[i]);
+
+	for(size_t n = 0; n < lookups; ++n)
+	{
+		/* Half of the keys are near a host, to reach the deep lines. */
+		Key key = Key::GetRandomKey();
+		if(n % 2)
+		{
+			uint32_t t[Key::nlen];
+			Key near = hosts[(size_t) rand() % hosts.size()].GetKey();
+			for(size_t i = 0; i < Key::nlen; ++i)
+				t[i] = near.GetArray()[i];
+			t[(size_t) rand() % Key::nlen] ^= 1u << (rand() % 32);
+			key = Key(t);
+		}
+
+		size_t my_digits = me.CommonPrefixBits(key) / DIGIT_BITS;
+		size_t row = my_digits < Table::MAX_ROW ? my_digits : Table::MAX_ROW - 1;
+		Check(table.getRowIndex(key) == row, DIGIT_BITS, "row index", key);
+		Check(Table::getDigit(key, row) < Table::MAX_COL, DIGIT_BITS, "digit out of the columns", key);
+
+		bool expected = false;
+		for(size_t i = 1; i < hosts.size() && !expected; ++i)
+			expected = hosts[i].GetKey().CommonPrefixBits(key) / DIGIT_BITS > my_digits;
+
+		bool perfect;
+		Host next = table.routeLookup(key, &perfect);
+		Check(perfect == expected, DIGIT_BITS, "perfect match", key);
+		if(perfect)
+			Check(next.GetKey().CommonPrefixBits(key) / DIGIT_BITS > my_digits, DIGIT_BITS,
+			      "next hop doesn't share more digits", key);
+		else if(!next)
+			Check(false, DIGIT_BITS, "no next hop", key);
+	}
+
+	bool perfect;
+	Check(table.routeLookup(me, &perfect) == hosts[0], DIGIT_BITS, "lookup of the local key", me);
+
+	for(size_t i = 1; i < hosts.size(); ++i)
+		table.remove(hosts[i]);
+	Key key = Key::GetRandomKey();
+	Check(table.routeLookup(key, &perfect) == hosts[0] && !perfect, DIGIT_BITS, "lookup in an empty table", key);
+}
+
+/* Copies share their rows, a change to one of them must not show in the others. */
+template<size_t DIGIT_BITS>
+static void CheckCopies(const std::vector<Host>& hosts)
+{
+	typedef BasicRoutingTable<DIGIT_BITS, ROUTING_CELL_ENTRIES> Table;
+	Table table(hosts[0]);
+
+	for(size_t i = 1; i < hosts.size(); ++i)
+		table.add(hosts[i]);
+
+	Table copy(table);
+	size_t entries = copy.getCopy().size();
+	for(size_t i = 1; i < hosts.size(); i += 2)
+		table.remove(hosts[i]);
+	Check(copy.getCopy().size() == entries, DIGIT_BITS, "removal seen by a copy", hosts[0].GetKey());
+	Check(table.getCopy().size() < entries, DIGIT_BITS, "removal not done", hosts[0].GetKey());
+
+	Table assigned(hosts[0]);
+	assigned = copy;
+	copy.KeyUpdate(hosts[0]);
+	Check(copy.getCopy().empty(), DIGIT_BITS, "table not cleared", hosts[0].GetKey());
+	Check(assigned.getCopy().size() == entries, DIGIT_BITS, "clear seen by a copy", hosts[0].GetKey());
+}
+
+/* Every perfect match solves a digit, so a route has at most MAX_ROW hops. */
+template<size_t DIGIT_BITS>
+static void CheckRoutes(const std::vector<Host>& hosts, size_t routes)
+{
+	typedef BasicRoutingTable<DIGIT_BITS, ROUTING_CELL_ENTRIES> Table;
+	std::vector<Table*> tables;
+	size_t total_hops = 0;
+
+	for(size_t i = 0; i < hosts.size(); ++i)
+	{
+		tables.push_back(new Table(hosts[i]));
+		for(size_t j = 0; j < hosts.size(); ++j)
+			if(j != i)
+				tables[i]->add(hosts[j]);
+	}
+
+	for(size_t n = 0; n < routes; ++n)
+	{
+		Key key = Key::GetRandomKey();
+		size_t node = (size_t) rand() % hosts.size();
+		size_t hops = 0;
+		bool perfect = true;
+
+		while(perfect && hops <= Table::MAX_ROW)
+		{
+			Host next = tables[node]->routeLookup(key, &perfect);
+			if(!perfect)
+				break;
+
+			size_t i;
+			for(i = 0; i < hosts.size() && hosts[i].GetKey() != next.GetKey(); ++i)
+				;
+			Check(i < hosts.size(), DIGIT_BITS, "next hop isn't a known host", key);
+			if(i == hosts.size())
+				break;
+			node = i;
+			hops++;
+		}
+		Check(hops <= Table::MAX_ROW, DIGIT_BITS, "route doesn't end", key);
+		total_hops += hops;
+	}
+
+	printf("b=%zu: %zu lines x %zu columns, %.2f hops per route\n", DIGIT_BITS,
+	       Table::MAX_ROW, Table::MAX_COL, (double) total_hops / (double) routes);
+
+	for(size_t i = 0; i < tables.size(); ++i)
+		delete tables[i];
+}
+
+int main(int argc, char** argv)
+{
+	size_t nb_hosts = argc > 1 ? (size_t) atol(argv[1]) : 300;
+	size_t lookups = argc > 2 ? (size_t) atol(argv[2]) : 20000;
+
+	srand(42);
+
+	std::vector<Host> hosts;
+	for(size_t i = 0; i < nb_hosts; ++i)
+		hosts.push_back(hosts_list.GetHost(pf_addr(htonl(INADDR_LOOPBACK), (uint16_t) (10000 + i),
+		                                           Key::GetRandomKey())));
+
+	CheckLookups<2>(hosts, lookups);
+	CheckLookups<ROUTING_DIGIT_BITS>(hosts, lookups);
+	CheckLookups<6>(hosts, lookups);
+
+	CheckCopies<2>(hosts);
+	CheckCopies<ROUTING_DIGIT_BITS>(hosts);
+	CheckCopies<6>(hosts);
+
+	CheckRoutes<2>(hosts, lookups / 10);
+	CheckRoutes<ROUTING_DIGIT_BITS>(hosts, lookups / 10);
+	CheckRoutes<6>(hosts, lookups / 10);
+
+	if(failures)
+	{
+		printf("%zu failures\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("%zu lookups checked for each digit size\n", lookups);
+	return EXIT_SUCCESS;
+}